@@ -0,0 +1,86 @@
+#include "allocation_audit.hpp"
+
+#ifdef HAVE_ALLOCATION_AUDIT
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<bool> _auditing {false};
+    std::atomic<int> _exemptions {0};
+    std::atomic<size_t> _allocations {0};
+
+    void* Allocate(size_t size) noexcept {
+        if (_auditing.load(std::memory_order_relaxed) && _exemptions.load(std::memory_order_relaxed) == 0) {
+            _allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return std::malloc(size == 0 ? 1 : size);
+    }
+}
+
+void AllocationAuditBegin() noexcept {
+    _allocations.store(0, std::memory_order_relaxed);
+    _auditing.store(true, std::memory_order_relaxed);
+}
+
+size_t AllocationAuditEnd() noexcept {
+    _auditing.store(false, std::memory_order_relaxed);
+    return _allocations.load(std::memory_order_relaxed);
+}
+
+AllocationAuditExemption::AllocationAuditExemption() noexcept {
+    _exemptions.fetch_add(1, std::memory_order_relaxed);
+}
+
+AllocationAuditExemption::~AllocationAuditExemption() noexcept {
+    _exemptions.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// Over-aligned allocations go through the standard library's own operators and aren't counted
+void* operator new(size_t size) {
+    if (void* p = Allocate(size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    if (void* p = Allocate(size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return Allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+#ifdef HAVE_ALLOCATION_AUDIT
+// Counts the core's calls to operator new, on any thread, while an audit is open.
+// The core is linked so that it binds to its own replacement operators,
+// which the frontend (having loaded the core privately) never sees; only the core's allocations are counted.
+// Memory that C code gets from malloc directly isn't counted either.
+void AllocationAuditBegin() noexcept;
+
+// Closes the audit and returns how many allocations it counted
+[[nodiscard]] size_t AllocationAuditEnd() noexcept;
+
+// Allocations made while one of these exists aren't counted;
+// it's for work that happens mid-session but only when something changes, like applying new options.
+class AllocationAuditExemption {
+public:
+    AllocationAuditExemption() noexcept;
+    ~AllocationAuditExemption() noexcept;
+    AllocationAuditExemption(const AllocationAuditExemption&) = delete;
+    AllocationAuditExemption& operator=(const AllocationAuditExemption&) = delete;
+    AllocationAuditExemption(AllocationAuditExemption&&) = delete;
+    AllocationAuditExemption& operator=(AllocationAuditExemption&&) = delete;
+};
+
+#define ALLOCATION_AUDIT_CONCAT_INNER(a, b) a##b
+#define ALLOCATION_AUDIT_CONCAT(a, b) ALLOCATION_AUDIT_CONCAT_INNER(a, b)
+#define ALLOCATION_AUDIT_EXEMPT() AllocationAuditExemption ALLOCATION_AUDIT_CONCAT(_allocationAuditExemption, __LINE__) {}
+#else
+#define ALLOCATION_AUDIT_EXEMPT() do {} while (0)
+#endif
@@ -0,0 +1,169 @@
+#include "atlas.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include <retro_assert.h>
+
+#include "damage.hpp"
+
+namespace {
+    constexpr int MIN_ATLAS_WIDTH = 256;
+
+    pntr_color* GetRow(const pntr_image& image, int y) noexcept {
+        return reinterpret_cast<pntr_color*>(reinterpret_cast<uint8_t*>(image.data) + static_cast<ptrdiff_t>(y) * image.pitch);
+    }
+
+    // Blends translucent source pixels over opaque destination pixels.
+    // Two channels are blended at once in each half of a 32-bit word;
+    // each channel's product fits in 16 bits, so they never spill into each other.
+    void BlendSpan(pntr_color* dst, const pntr_color* src, size_t count) noexcept {
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t alpha = src[i].rgba.a;
+            alpha += alpha >> 7; // Map [0, 255] onto [0, 256] so that 255 is fully opaque
+            uint32_t inverse = 256 - alpha;
+
+            uint32_t s = src[i].value;
+            uint32_t d = dst[i].value;
+            uint32_t low = (((s & 0x00FF00FFu) * alpha + (d & 0x00FF00FFu) * inverse) >> 8) & 0x00FF00FFu;
+            uint32_t high = (((s >> 8) & 0x00FF00FFu) * alpha + ((d >> 8) & 0x00FF00FFu) * inverse) & 0xFF00FF00u;
+
+            pntr_color out;
+            out.value = low | high;
+            out.rgba.a = 255;
+            dst[i] = out;
+        }
+    }
+}
+
+SpriteAtlas::SpriteAtlas(nonstd::span<pntr_image* const> images) noexcept {
+    retro_assert(!images.empty());
+
+    // Shelf packing: place the tallest frames first, left to right, starting a new shelf when a row fills up
+    std::vector<size_t> order(images.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&images](size_t a, size_t b) {
+        return images[a]->height > images[b]->height;
+    });
+
+    int width = MIN_ATLAS_WIDTH;
+    for (const pntr_image* image : images) {
+        width = std::max(width, image->width);
+    }
+
+    _frames.resize(images.size());
+    int x = 0, y = 0, shelfHeight = 0;
+    for (size_t index : order) {
+        const pntr_image* image = images[index];
+        if (x + image->width > width) {
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+
+        _frames[index].rect = { x, y, image->width, image->height };
+        x += image->width;
+        shelfHeight = std::max(shelfHeight, image->height);
+    }
+
+    _image = pntr_new_image(width, y + shelfHeight);
+    retro_assert(_image != nullptr);
+
+    for (size_t i = 0; i < images.size(); ++i) {
+        const pntr_image& image = *images[i];
+        AtlasFrame& frame = _frames[i];
+
+        // Copy the raw pixels; a blit would blend them with the (transparent) atlas
+        for (int row = 0; row < image.height; ++row) {
+            memcpy(GetRow(*_image, frame.rect.y + row) + frame.rect.x, GetRow(image, row), image.width * sizeof(pntr_color));
+        }
+
+        frame.firstRun = static_cast<uint32_t>(_runs.size());
+        for (int row = 0; row < image.height; ++row) {
+            const pntr_color* pixels = GetRow(image, row);
+            int column = 0;
+            while (column < image.width) {
+                uint8_t alpha = pixels[column].rgba.a;
+                if (alpha == 0) {
+                    ++column;
+                    continue;
+                }
+
+                bool opaque = alpha == 255;
+                int start = column;
+                while (column < image.width && pixels[column].rgba.a != 0 && (pixels[column].rgba.a == 255) == opaque) {
+                    ++column;
+                }
+
+                _runs.push_back({
+                    static_cast<uint16_t>(row),
+                    static_cast<uint16_t>(start),
+                    static_cast<uint16_t>(column - start),
+                    opaque
+                });
+            }
+        }
+        frame.runCount = static_cast<uint32_t>(_runs.size()) - frame.firstRun;
+    }
+}
+
+SpriteAtlas::~SpriteAtlas() noexcept {
+    pntr_unload_image(_image);
+    _image = nullptr;
+}
+
+SpriteAtlas::SpriteAtlas(SpriteAtlas&& other) noexcept :
+    _image(other._image),
+    _frames(std::move(other._frames)),
+    _runs(std::move(other._runs))
+{
+    other._image = nullptr;
+}
+
+SpriteAtlas& SpriteAtlas::operator=(SpriteAtlas&& other) noexcept {
+    if (this != &other) {
+        pntr_unload_image(_image);
+        _image = other._image;
+        _frames = std::move(other._frames);
+        _runs = std::move(other._runs);
+        other._image = nullptr;
+    }
+    return *this;
+}
+
+void SpriteAtlas::Draw(pntr_image& dst, uint32_t index, int x, int y, pntr_rectangle clip) const noexcept {
+    const AtlasFrame& frame = _frames[index];
+    clip = RectIntersection(clip, { 0, 0, dst.width, dst.height });
+    if (RectIsEmpty(RectIntersection(clip, { x, y, frame.rect.width, frame.rect.height })))
+        return;
+
+    int clipRight = clip.x + clip.width;
+    int clipBottom = clip.y + clip.height;
+    const SpriteRun* runs = _runs.data() + frame.firstRun;
+
+    for (uint32_t r = 0; r < frame.runCount; ++r) {
+        const SpriteRun& run = runs[r];
+        int dy = y + run.row;
+        if (dy < clip.y)
+            continue;
+
+        if (dy >= clipBottom)
+            break; // Runs are sorted by row, so the rest are below the clip too
+
+        int left = std::max(x + run.x, clip.x);
+        int right = std::min(x + run.x + run.length, clipRight);
+        if (left >= right)
+            continue;
+
+        pntr_color* out = GetRow(dst, dy) + left;
+        const pntr_color* in = GetRow(*_image, frame.rect.y + run.row) + frame.rect.x + (left - x);
+        size_t count = right - left;
+
+        if (run.opaque) {
+            memcpy(out, in, count * sizeof(pntr_color));
+        } else {
+            BlendSpan(out, in, count);
+        }
+    }
+}
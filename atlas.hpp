@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <pntr.h>
+
+#include <nonstd/span.hpp>
+
+// A horizontal stretch of one sprite row whose pixels are either all opaque or all translucent.
+// Fully transparent pixels aren't covered by any run, so they're never touched.
+struct SpriteRun {
+    uint16_t row; // Relative to the frame's top edge
+    uint16_t x;   // Relative to the frame's left edge
+    uint16_t length;
+    bool opaque;
+};
+
+struct AtlasFrame {
+    pntr_rectangle rect; // Where the frame's pixels live in the atlas
+    uint32_t firstRun;   // The frame's runs are contiguous and sorted by row
+    uint32_t runCount;
+};
+
+// Many small sprites packed into one image, each with a precomputed table of pixel runs.
+// Drawing a frame walks its runs instead of testing every pixel's alpha,
+// copying opaque runs outright and blending only the translucent ones.
+class SpriteAtlas {
+public:
+    SpriteAtlas() noexcept = default;
+
+    // Copies the given images into the atlas, in order; frame i is images[i].
+    explicit SpriteAtlas(nonstd::span<pntr_image* const> images) noexcept;
+    ~SpriteAtlas() noexcept;
+    SpriteAtlas(const SpriteAtlas&) = delete;
+    SpriteAtlas& operator=(const SpriteAtlas&) = delete;
+    SpriteAtlas(SpriteAtlas&&) noexcept;
+    SpriteAtlas& operator=(SpriteAtlas&&) noexcept;
+
+    [[nodiscard]] size_t GetFrameCount() const noexcept { return _frames.size(); }
+    [[nodiscard]] const AtlasFrame& GetFrame(uint32_t frame) const noexcept { return _frames[frame]; }
+    [[nodiscard]] const pntr_image* GetImage() const noexcept { return _image; }
+
+    // Draws a frame with its top-left corner at (x, y), touching only pixels inside clip.
+    // The destination is assumed to be opaque (as the framebuffer always is),
+    // which lets translucent pixels skip most of a general alpha blend.
+    void Draw(pntr_image& dst, uint32_t frame, int x, int y, pntr_rectangle clip) const noexcept;
+
+private:
+    pntr_image* _image = nullptr;
+    std::vector<AtlasFrame> _frames;
+    std::vector<SpriteRun> _runs;
+};
+
+// A contiguous range of frames within an atlas, e.g. all the frames of one particle effect.
+struct SpriteFrames {
+    const SpriteAtlas* atlas = nullptr;
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
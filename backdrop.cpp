@@ -0,0 +1,79 @@
+#include "backdrop.hpp"
+
+#include <cstring>
+
+#include "background.hpp"
+#include "cart.hpp"
+#include "damage.hpp"
+
+Backdrop::~Backdrop() noexcept {
+    pntr_unload_image(_cache);
+    _cache = nullptr;
+}
+
+void Backdrop::Reserve(int width, int height) noexcept {
+    _valid = false;
+    if (_cache && _cache->width == width && _cache->height == height)
+        return;
+
+    pntr_unload_image(_cache);
+    _cache = pntr_new_image(width, height);
+}
+
+void Backdrop::Update(const Background& background, const Cart* staticCart) noexcept {
+    if (&background != _background) {
+        _background = &background;
+        _valid = false;
+    }
+
+    if (!staticCart) {
+        _valid = false;
+        return;
+    }
+
+    pntr_rectangle bounds = staticCart->GetBounds();
+    if (_valid && RectEquals(bounds, _bounds))
+        return;
+
+    if (!_cache || _cache->width != bounds.width || _cache->height != bounds.height) {
+        Reserve(bounds.width, bounds.height);
+        if (!_cache)
+            return; // Fall back to drawing the layers separately
+    }
+
+    size_t stride = _cache->pitch / sizeof(pntr_color);
+    for (int y = 0; y < bounds.height; ++y) {
+        FillSpan(_cache->data + y * stride, bounds.width, background.GetRowColor(bounds.y + y));
+    }
+    DrawImageClipped(*_cache, staticCart->GetImage(), 0, 0, { 0, 0, bounds.width, bounds.height });
+
+    _bounds = bounds;
+    _valid = true;
+}
+
+void Backdrop::Draw(pntr_image& framebuffer, pntr_rectangle clip) const noexcept {
+    pntr_rectangle cached = _valid ? RectIntersection(clip, _bounds) : pntr_rectangle {};
+    if (RectIsEmpty(cached)) {
+        if (_background) {
+            _background->Draw(framebuffer, clip);
+        }
+        return;
+    }
+
+    // Fill the background above, below, left and right of the cached part of the clip
+    if (_background) {
+        int clipBottom = clip.y + clip.height;
+        int cachedBottom = cached.y + cached.height;
+        _background->Draw(framebuffer, { clip.x, clip.y, clip.width, cached.y - clip.y });
+        _background->Draw(framebuffer, { clip.x, cachedBottom, clip.width, clipBottom - cachedBottom });
+        _background->Draw(framebuffer, { clip.x, cached.y, cached.x - clip.x, cached.height });
+        _background->Draw(framebuffer, { cached.x + cached.width, cached.y, clip.x + clip.width - cached.x - cached.width, cached.height });
+    }
+
+    size_t dstStride = framebuffer.pitch / sizeof(pntr_color);
+    size_t srcStride = _cache->pitch / sizeof(pntr_color);
+    for (int y = cached.y; y < cached.y + cached.height; ++y) {
+        const pntr_color* src = _cache->data + (y - _bounds.y) * srcStride + (cached.x - _bounds.x);
+        memcpy(framebuffer.data + y * dstStride + cached.x, src, cached.width * sizeof(pntr_color));
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <pntr.h>
+
+class Background;
+class Cart;
+
+// The static layers of the scene (the background and, once it settles, the cart) flattened into one opaque image.
+// Only the cart's bounds are cached; the rest of the background is cheaper to fill than to copy.
+// The cache is rebuilt whenever the layers it was built from change.
+class Backdrop {
+public:
+    Backdrop() noexcept = default;
+    ~Backdrop() noexcept;
+    Backdrop(const Backdrop&) = delete;
+    Backdrop& operator=(const Backdrop&) = delete;
+    Backdrop(Backdrop&&) = delete;
+    Backdrop& operator=(Backdrop&&) = delete;
+
+    // Call on the main thread before drawing.
+    // The cart is only flattened in while it holds still; pass null while it's moving or animating.
+    // Both layers are borrowed until the next call.
+    void Update(const Background& background, const Cart* staticCart) noexcept;
+
+    // Allocates the cache up front for a cart of this size; also invalidates it
+    void Reserve(int width, int height) noexcept;
+
+    // Forces the cache to be rebuilt, e.g. after a layer changes in a way Update can't see
+    void Invalidate() noexcept { _valid = false; }
+
+    // Whether the cart is part of the backdrop, in which case it mustn't be drawn again
+    [[nodiscard]] bool HasCart() const noexcept { return _valid; }
+
+    // Draws the static layers inside clip; only reads the cache, so it's safe to call from several threads.
+    void Draw(pntr_image& framebuffer, pntr_rectangle clip) const noexcept;
+
+private:
+    const Background* _background = nullptr;
+    pntr_image* _cache = nullptr;
+    pntr_rectangle _bounds {}; // Where the cache goes on screen
+    bool _valid = false;
+};
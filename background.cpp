@@ -0,0 +1,63 @@
+#include "background.hpp"
+
+#include <algorithm>
+
+#include "damage.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ROMCLEANER_BACKGROUND_SSE2
+#include <emmintrin.h>
+#elif defined(HAVE_NEON)
+#define ROMCLEANER_BACKGROUND_NEON
+#include <arm_neon.h>
+#endif
+
+void FillSpan(pntr_color* dst, size_t count, pntr_color color) noexcept {
+    size_t i = 0;
+#if defined(ROMCLEANER_BACKGROUND_SSE2)
+    const __m128i value = _mm_set1_epi32(static_cast<int>(color.value));
+    for (; i + 16 <= count; i += 16) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 12), value);
+    }
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), value);
+    }
+#elif defined(ROMCLEANER_BACKGROUND_NEON)
+    const uint32x4_t value = vdupq_n_u32(color.value);
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u32(reinterpret_cast<uint32_t*>(dst + i), value);
+    }
+#endif
+
+    for (; i < count; ++i) {
+        dst[i] = color;
+    }
+}
+
+// Matches pntr_draw_rectangle_gradient with the same color in both top corners and both bottom corners
+Background::Background(int height, pntr_color top, pntr_color bottom) : _rows(static_cast<size_t>(std::max(height, 0))) {
+    for (int y = 0; y < height; ++y) {
+        _rows[y] = pntr_color_lerp(top, bottom, static_cast<float>(y) / height);
+    }
+}
+
+void Background::Draw(pntr_image& framebuffer, pntr_rectangle clip) const noexcept {
+    clip = RectIntersection(clip, { 0, 0, framebuffer.width, std::min(framebuffer.height, static_cast<int>(_rows.size())) });
+    if (RectIsEmpty(clip))
+        return;
+
+    size_t stride = framebuffer.pitch / sizeof(pntr_color);
+    for (int y = clip.y; y < clip.y + clip.height; ++y) {
+        FillSpan(framebuffer.data + y * stride + clip.x, clip.width, _rows[y]);
+    }
+}
+
+pntr_color Background::GetRowColor(int y) const noexcept {
+    if (_rows.empty())
+        return {};
+
+    return _rows[std::clamp(y, 0, static_cast<int>(_rows.size()) - 1)];
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <pntr.h>
+
+// Sets count pixels starting at dst to color.
+void FillSpan(pntr_color* dst, size_t count, pntr_color color) noexcept;
+
+// A vertical gradient, drawn as one solid color per row.
+// Only the per-row colors are stored, so drawing the background never reads more than one value per row.
+class Background {
+public:
+    Background() noexcept = default;
+    Background(int height, pntr_color top, pntr_color bottom);
+
+    // Fills the part of the framebuffer inside clip
+    void Draw(pntr_image& framebuffer, pntr_rectangle clip) const noexcept;
+
+    // The color of screen row y; rows outside the gradient take the nearest edge's color
+    [[nodiscard]] pntr_color GetRowColor(int y) const noexcept;
+
+private:
+    std::vector<pntr_color> _rows;
+};
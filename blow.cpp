@@ -4,35 +4,77 @@
 
 #include "blow.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 #include "constants.hpp"
+#include "profiler.hpp"
+#include "serialize.hpp"
 
-BlowDetector::BlowDetector() :
-    _fftConfig(kiss_fft_alloc(SAMPLES_PER_FRAME, 0, nullptr, nullptr))
-{
+// Returns the first FFT bin whose center frequency satisfies the predicate
+template<typename Predicate>
+static size_t FirstBin(Predicate predicate) {
+    constexpr double binSize = SAMPLE_RATE / static_cast<double>(FFT_SIZE);
+    size_t bin = 1;
+    while (bin < FFT_BINS && !predicate(bin * binSize)) {
+        ++bin;
+    }
+    return bin;
 }
 
-BlowDetector::BlowDetector(BlowDetector&& other) noexcept :
-    _fftConfig(other._fftConfig),
-    _adaptiveThreshold(other._adaptiveThreshold),
-    _historyIndex(other._historyIndex),
-    _detectionHistory(other._detectionHistory),
-    _backgroundLevels(other._backgroundLevels),
-    _bgIndex(other._bgIndex)
+BlowDetector::BlowDetector(const BlowDetectorArgs& args) :
+    _args(args),
+    _fftConfig(kiss_fftr_alloc(FFT_SIZE, 0, nullptr, nullptr))
 {
-    other._fftConfig = nullptr;
+    _args.frameSize = std::clamp<size_t>(_args.frameSize, 2, FFT_SIZE);
+    _args.hopSize = std::clamp<size_t>(_args.hopSize, 1, _args.frameSize);
+
+    for (size_t i = 0; i < _args.frameSize; i++) {
+        double hann = 0.5 * (1.0 - std::cos(2.0 * M_PI * i / (_args.frameSize - 1)));
+        _window[i] = static_cast<float>(hann / 32768.0);
+    }
+
+    _lowFreqEnd = FirstBin([](double freq) { return freq >= LOW_FREQ_LIMIT; });
+    _signatureBegin = FirstBin([](double freq) { return freq > SIGNATURE_LOW_FREQ; });
+    _signatureEnd = FirstBin([](double freq) { return freq >= SIGNATURE_HIGH_FREQ; });
+
+    double historyLength = std::round(SMOOTHING_FRAMES * SAMPLES_PER_FRAME / static_cast<double>(_args.hopSize));
+    _historyLength = std::clamp<size_t>(historyLength, 1, MAX_HISTORY);
+
+    // Falls between 1/3 and 1/2 of the history; with 6 decisions, this requires at least 2 positive ones
+    _requiredDetections = (_historyLength + 2) / 3;
+
+    _nextFrameEnd = _args.frameSize;
+}
+
+BlowDetector::BlowDetector(BlowDetector&& other) noexcept {
+    *this = std::move(other);
 }
 
 BlowDetector& BlowDetector::operator=(BlowDetector&& other) noexcept {
     if (this != &other) {
         if (_fftConfig) {
-            kiss_fft_free(_fftConfig);
+            kiss_fftr_free(_fftConfig);
         }
+        _args = other._args;
         _fftConfig = other._fftConfig;
+        _window = other._window;
+        _lowFreqEnd = other._lowFreqEnd;
+        _signatureBegin = other._signatureBegin;
+        _signatureEnd = other._signatureEnd;
+        _historyLength = other._historyLength;
+        _requiredDetections = other._requiredDetections;
+        _ring = other._ring;
+        _samplesWritten = other._samplesWritten;
+        _nextFrameEnd = other._nextFrameEnd;
+        _blowing = other._blowing;
         _adaptiveThreshold = other._adaptiveThreshold;
         _historyIndex = other._historyIndex;
         _detectionHistory = other._detectionHistory;
         _backgroundLevels = other._backgroundLevels;
         _bgIndex = other._bgIndex;
+        _bgSpectrum = other._bgSpectrum;
+        _spectrumUpdateCounter = other._spectrumUpdateCounter;
 
         other._fftConfig = nullptr;
     }
@@ -41,12 +83,48 @@ BlowDetector& BlowDetector::operator=(BlowDetector&& other) noexcept {
 
 BlowDetector::~BlowDetector() {
     if (_fftConfig) {
-        kiss_fft_free(_fftConfig);
+        kiss_fftr_free(_fftConfig);
         _fftConfig = nullptr;
     }
 }
 
-bool BlowDetector::IsBlowing(nonstd::span<const int16_t> samples) {
+size_t BlowDetector::Push(nonstd::span<const int16_t> samples) noexcept {
+    PROFILE_SCOPE(BlowDetect);
+
+    size_t framesAnalyzed = 0;
+
+    while (!samples.empty()) {
+        // Never buffer past the end of the next frame, so that the ring can't overwrite it
+        size_t count = std::min(samples.size(), _nextFrameEnd - _samplesWritten);
+        for (size_t i = 0; i < count; ++i) {
+            _ring[(_samplesWritten + i) % SAMPLE_RING_SIZE] = samples[i];
+        }
+        _samplesWritten += count;
+        samples = samples.subspan(count);
+
+        if (_samplesWritten == _nextFrameEnd) {
+            // Unwrap the frame so the analysis can treat it as one contiguous block
+            std::array<int16_t, FFT_SIZE> frame;
+            size_t frameStart = _nextFrameEnd - _args.frameSize;
+            for (size_t i = 0; i < _args.frameSize; ++i) {
+                frame[i] = _ring[(frameStart + i) % SAMPLE_RING_SIZE];
+            }
+
+            _blowing = AnalyzeFrame({frame.data(), _args.frameSize});
+            _nextFrameEnd += _args.hopSize;
+            ++framesAnalyzed;
+        }
+    }
+
+    return framesAnalyzed;
+}
+
+void BlowDetector::RecordDetection(bool detection) noexcept {
+    _detectionHistory[_historyIndex] = detection;
+    _historyIndex = (_historyIndex + 1) % _historyLength;
+}
+
+bool BlowDetector::AnalyzeFrame(nonstd::span<const int16_t> samples) {
     // Compute RMS Energy
     double rms = 0.0;
     for (int16_t sample : samples) {
@@ -68,35 +146,33 @@ bool BlowDetector::IsBlowing(nonstd::span<const int16_t> samples) {
 
     // Early exit if too quiet
     if (rms < _adaptiveThreshold) {
-        _detectionHistory[_historyIndex] = false;
-        _historyIndex = (_historyIndex + 1) % SMOOTHING_FRAMES;
+        RecordDetection(false);
         return false;
     }
 
-    // Convert samples for FFT with window function
-    std::array<kiss_fft_cpx, SAMPLES_PER_FRAME> in, out;
+    // Window the samples; anything past the end of the frame stays zero
+    std::array<kiss_fft_scalar, FFT_SIZE> in {};
+    std::array<kiss_fft_cpx, FFT_BINS> out;
     for (size_t i = 0; i < samples.size(); i++) {
-        float window = 0.5f * (1.0f - cos(2.0f * M_PI * i / (samples.size() - 1)));
-        in[i].r = static_cast<float>(samples[i]) / 32768.0f * window;
-        in[i].i = 0;
+        in[i] = samples[i] * _window[i];
     }
 
     // Execute FFT
-    kiss_fft(_fftConfig, in.data(), out.data());
+    kiss_fftr(_fftConfig, in.data(), out.data());
 
     // Analyze frequency content
-    double bin_size = SAMPLE_RATE / static_cast<double>(samples.size());
     double low_freq_energy = 0.0, total_energy = 0.0;
     double blow_signature_energy = 0.0;
     double signature_peak = 0.0;
+    bool updateBackground = rms < _adaptiveThreshold * 0.8;
 
     // Skip DC component (i=0)
-    for (int i = 1; i < samples.size() / 2; i++) {
-        double freq = i * bin_size;
-        double magnitude = sqrt(out[i].r * out[i].r + out[i].i * out[i].i);
+    for (size_t i = 1; i < FFT_SIZE / 2; i++) {
+        // The thresholds below are tuned for sums of magnitudes, not of powers, so every bin needs its square root
+        double magnitude = std::sqrt(out[i].r * out[i].r + out[i].i * out[i].i);
 
         // Update background spectrum during quiet periods
-        if (rms < _adaptiveThreshold * 0.8 && _spectrumUpdateCounter++ % 10 == 0) {
+        if (updateBackground && _spectrumUpdateCounter++ % 10 == 0) {
             _bgSpectrum[i] = _bgSpectrum[i] * 0.95 + magnitude * 0.05; // Slow update
         }
 
@@ -105,11 +181,11 @@ bool BlowDetector::IsBlowing(nonstd::span<const int16_t> samples) {
 
         total_energy += magnitude;
 
-        if (freq < LOW_FREQ_LIMIT) {
+        if (i < _lowFreqEnd) {
             low_freq_energy += magnitude;
 
             // Look for blow signature (focused energy in 150-500Hz range)
-            if (freq > 150 && freq < 500) {
+            if (i >= _signatureBegin && i < _signatureEnd) {
                 blow_signature_energy += magnitude;
                 signature_peak = std::max(signature_peak, magnitude);
             }
@@ -118,30 +194,80 @@ bool BlowDetector::IsBlowing(nonstd::span<const int16_t> samples) {
 
     // Skip detection if total energy is too low after noise reduction
     if (total_energy < 0.005) { // Lower energy threshold
-        _detectionHistory[_historyIndex] = false;
-        _historyIndex = (_historyIndex + 1) % SMOOTHING_FRAMES;
+        RecordDetection(false);
         return false;
     }
 
     // More balanced criteria for blow detection
     bool frequencyRatio = (total_energy > 0) && ((low_freq_energy / total_energy) > BLOW_RATIO);
     bool signatureStrength = (total_energy > 0) && ((blow_signature_energy / total_energy) > 0.3); // Lower threshold
-    bool signaturePeak = signature_peak > (total_energy / samples.size() * 3.0); // Lower ratio
+    // The peak is compared against the average bin, so that it doesn't depend on the frame size
+    // (this used to be total / frame size * 3, when there were half as many bins as samples)
+    constexpr double analyzedBins = FFT_SIZE / 2 - 1;
+    bool signaturePeak = signature_peak > (total_energy / analyzedBins * 1.5); // Lower ratio
 
     // Use OR instead of AND to catch more potential blow patterns
     bool currentDetection = frequencyRatio || (signatureStrength && signaturePeak);
 
     // Update history
-    _detectionHistory[_historyIndex] = currentDetection;
-    _historyIndex = (_historyIndex + 1) % SMOOTHING_FRAMES;
+    RecordDetection(currentDetection);
 
     // Count positive detections in history
-    int positiveCount = 0;
+    size_t positiveCount = 0;
+    for (size_t i = 0; i < _historyLength; i++) {
+        if (_detectionHistory[i]) positiveCount++;
+    }
+
+    return positiveCount >= _requiredDetections;
+}
+
+void BlowDetector::Serialize(StateWriter& writer) const noexcept {
+    writer.WriteSize(_args.frameSize);
+    writer.WriteSize(_args.hopSize);
+    writer.WriteArray(nonstd::span<const int16_t>(_ring));
+    writer.WriteSize(_samplesWritten);
+    writer.WriteSize(_nextFrameEnd);
+    writer.Write(_blowing);
+    writer.Write(_adaptiveThreshold);
+    writer.WriteSize(_historyIndex);
     for (bool detection : _detectionHistory) {
-        if (detection) positiveCount++;
+        writer.Write(detection);
     }
+    writer.WriteArray(nonstd::span<const double>(_backgroundLevels));
+    writer.WriteSize(_bgIndex);
+    writer.WriteArray(nonstd::span<const double>(_bgSpectrum));
+    writer.Write(_spectrumUpdateCounter);
+}
 
-    // Use a more balanced threshold that falls between 1/3 and 1/2
-    // With SMOOTHING_FRAMES=6, this requires at least 2 positive frames
-    return positiveCount >= 2;
-}
\ No newline at end of file
+bool BlowDetector::Unserialize(StateReader& reader) noexcept {
+    size_t frameSize = 0, hopSize = 0;
+    reader.ReadSize(frameSize);
+    reader.ReadSize(hopSize);
+    if (!reader.IsOk() || frameSize != _args.frameSize || hopSize != _args.hopSize) {
+        reader.Fail();
+        return false;
+    }
+
+    reader.ReadArray(nonstd::span<int16_t>(_ring));
+    reader.ReadSize(_samplesWritten);
+    reader.ReadSize(_nextFrameEnd);
+    reader.Read(_blowing);
+    reader.Read(_adaptiveThreshold);
+    reader.ReadSize(_historyIndex);
+    for (bool& detection : _detectionHistory) {
+        reader.Read(detection);
+    }
+    reader.ReadArray(nonstd::span<double>(_backgroundLevels));
+    reader.ReadSize(_bgIndex);
+    reader.ReadArray(nonstd::span<double>(_bgSpectrum));
+    reader.Read(_spectrumUpdateCounter);
+
+    // Push relies on the next frame always being ahead of, but within one frame of, the write position
+    bool frameInRange = _nextFrameEnd > _samplesWritten && _nextFrameEnd - _samplesWritten <= _args.frameSize;
+    if (!frameInRange || _historyIndex >= _historyLength || _bgIndex >= _backgroundLevels.size()) {
+        reader.Fail();
+    }
+
+    // A detector that fails to load is left half-restored; the caller puts back the state it had before
+    return reader.IsOk();
+}
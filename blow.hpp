@@ -2,7 +2,7 @@
 
 #include <array>
 #include <cstdint>
-#include <kiss_fft.h>
+#include <kiss_fftr.h>
 #include <nonstd/span.hpp>
 
 #include "constants.hpp"
@@ -12,24 +12,86 @@ static constexpr float BLOW_RATIO = 0.55f; // More lenient ratio
 static constexpr int SMOOTHING_FRAMES = 6;
 static constexpr int LOW_FREQ_LIMIT = 600;  // Expanded range
 static constexpr int ADAPTIVE_WINDOW = 30;  // For background noise estimation
+static constexpr int SIGNATURE_LOW_FREQ = 150;  // Blows concentrate their energy between these frequencies
+static constexpr int SIGNATURE_HIGH_FREQ = 500;
 
+// Frames are zero-padded to a power of two, which the real-input FFT handles far faster than 735 points
+static constexpr size_t FFT_SIZE = 1024;
+static constexpr size_t FFT_BINS = FFT_SIZE / 2 + 1;
+static_assert(FFT_SIZE >= SAMPLES_PER_FRAME, "A whole frame must fit in the FFT");
+
+// Incoming samples are buffered here until there's enough for the next frame.
+// Must be a power of two that holds a full frame plus a full hop.
+static constexpr size_t SAMPLE_RING_SIZE = FFT_SIZE * 2;
+
+// Upper bound on how many decisions the detector smooths over
+static constexpr size_t MAX_HISTORY = 32;
+
+struct BlowDetectorArgs {
+    size_t frameSize = SAMPLES_PER_FRAME; // Samples analyzed at once, at most FFT_SIZE
+    size_t hopSize = SAMPLES_PER_FRAME / 2; // Samples between analyses; frames overlap by frameSize - hopSize
+};
+
+class StateReader;
+class StateWriter;
+
+// Analyzes a stream of microphone samples for the sound of someone blowing into it.
+// Samples can be pushed in chunks of any size;
+// a decision is made every hopSize samples, independently of the video frame rate.
 class BlowDetector {
 public:
-    BlowDetector();
+    explicit BlowDetector(const BlowDetectorArgs& args = {});
     ~BlowDetector();
     BlowDetector(const BlowDetector&) = delete;
     BlowDetector(BlowDetector&& other) noexcept;
     BlowDetector& operator=(const BlowDetector&) = delete;
     BlowDetector& operator=(BlowDetector&& other) noexcept;
-    bool IsBlowing(nonstd::span<const int16_t> samples);
+
+    // Buffers the samples and analyzes every frame they complete.
+    // Returns the number of frames that were analyzed.
+    size_t Push(nonstd::span<const int16_t> samples) noexcept;
+
+    // Whether the most recent analyzed frames sound like blowing
+    [[nodiscard]] bool IsBlowing() const noexcept { return _blowing; }
+
+    [[nodiscard]] const BlowDetectorArgs& GetArgs() const noexcept { return _args; }
+
+    // Saves the buffered samples and everything learned from past frames.
+    // A state can only be restored into a detector with the same frame and hop sizes.
+    // If Unserialize fails, the detector is left half-restored, so the caller has to put back its previous state.
+    void Serialize(StateWriter& writer) const noexcept;
+    bool Unserialize(StateReader& reader) noexcept;
 
 private:
-    kiss_fft_cfg _fftConfig = nullptr;
+    BlowDetectorArgs _args;
+    kiss_fftr_cfg _fftConfig = nullptr;
+
+    // Hann window with the int16-to-float scale folded in, computed once
+    std::array<float, FFT_SIZE> _window {};
+
+    // Bin ranges for the analyzed bands, computed once from the FFT size
+    size_t _lowFreqEnd = 0;  // First bin at or above LOW_FREQ_LIMIT
+    size_t _signatureBegin = 0;  // First bin above SIGNATURE_LOW_FREQ
+    size_t _signatureEnd = 0;  // First bin at or above SIGNATURE_HIGH_FREQ
+
+    // Smoothing covers about as much time as SMOOTHING_FRAMES video frames would,
+    // regardless of the hop size
+    size_t _historyLength = SMOOTHING_FRAMES;
+    size_t _requiredDetections = 2;
+
+    std::array<int16_t, SAMPLE_RING_SIZE> _ring {};
+    size_t _samplesWritten = 0; // Total samples ever pushed; the ring position is this modulo its size
+    size_t _nextFrameEnd = 0; // Value of _samplesWritten at which the next frame is complete
+    bool _blowing = false;
+
     double _adaptiveThreshold = RMS_THRESHOLD;
     size_t _historyIndex = 0;
-    std::array<bool, SMOOTHING_FRAMES> _detectionHistory = {};
+    std::array<bool, MAX_HISTORY> _detectionHistory = {};
     std::array<double, ADAPTIVE_WINDOW> _backgroundLevels = {};
     size_t _bgIndex = 0;
-    std::array<double, SAMPLES_PER_FRAME/2> _bgSpectrum {};
+    std::array<double, FFT_BINS> _bgSpectrum {};
     int _spectrumUpdateCounter = 0;
+
+    bool AnalyzeFrame(nonstd::span<const int16_t> samples);
+    void RecordDetection(bool detection) noexcept;
 };
\ No newline at end of file
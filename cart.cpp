@@ -6,41 +6,58 @@
 
 #include <retro_assert.h>
 
-Cart::Cart(nonstd::span<const uint8_t> image) noexcept :
-    _image(pntr_load_image_from_memory(PNTR_IMAGE_TYPE_PNG, image.data(), image.size()))
+#include "damage.hpp"
+#include "serialize.hpp"
+
+Cart::Cart(pntr_image* image) noexcept :
+    _image(image)
 {
     retro_assert(_image != nullptr);
 }
 
 Cart::Cart(Cart&& other) noexcept :
     _image(other._image),
-    _position(other._position)
+    _position(other._position),
+    _drawnBounds(other._drawnBounds)
 {
     other._image = nullptr;
 }
 
 Cart& Cart::operator=(Cart&& other) noexcept {
     if (this != &other) {
-        if (_image) {
-            pntr_unload_image(_image);
-        }
         _image = other._image;
         _position = other._position;
+        _drawnBounds = other._drawnBounds;
         other._image = nullptr;
     }
     return *this;
 }
 
-Cart::~Cart() {
-    pntr_unload_image(_image);
-}
+Cart::~Cart() = default;
 
 void Cart::Update() {
 
 }
 
-void Cart::Draw(pntr_image& framebuffer) {
+void Cart::Draw(pntr_image& framebuffer, pntr_rectangle clip) const noexcept {
+
+    DrawImageClipped(framebuffer, _image, _position.x, _position.y, clip);
+
+}
+
+void Cart::ReportDamage(DamageTracker& damage) noexcept {
+    pntr_rectangle bounds = GetBounds();
+    if (!RectEquals(bounds, _drawnBounds)) {
+        damage.Add(_drawnBounds);
+        damage.Add(bounds);
+        _drawnBounds = bounds;
+    }
+}
 
-    pntr_draw_image(&framebuffer, _image, _position.x, _position.y);
+void Cart::Serialize(StateWriter& writer) const noexcept {
+    writer.Write(_position);
+}
 
-}
\ No newline at end of file
+bool Cart::Unserialize(StateReader& reader) noexcept {
+    return reader.Read(_position);
+}
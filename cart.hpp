@@ -8,11 +8,14 @@
 #include <cstdint>
 #include <pntr.h>
 
-#include <nonstd/span.hpp>
+class DamageTracker;
+class StateReader;
+class StateWriter;
 
 class Cart {
 public:
-    Cart(nonstd::span<const uint8_t> image) noexcept;
+    // The image is borrowed, and must outlive the cart.
+    explicit Cart(pntr_image* image) noexcept;
     ~Cart();
     Cart(const Cart&) = delete;
     Cart& operator=(const Cart&) = delete;
@@ -20,7 +23,13 @@ public:
     Cart& operator=(Cart&&) noexcept;
 
     void Update();
-    void Draw(pntr_image& framebuffer);
+    void Draw(pntr_image& framebuffer, pntr_rectangle clip) const noexcept;
+
+    // Reports the cart's old and new bounds if it moved since it was last drawn.
+    void ReportDamage(DamageTracker& damage) noexcept;
+
+    void Serialize(StateWriter& writer) const noexcept;
+    bool Unserialize(StateReader& reader) noexcept;
 
     void SetPosition(int x, int y) {
         _position.x = x;
@@ -39,9 +48,18 @@ public:
         return { _image->width, _image->height };
     }
 
+    [[nodiscard]] pntr_rectangle GetBounds() const {
+        return { _position.x, _position.y, _image->width, _image->height };
+    }
+
+    [[nodiscard]] pntr_image* GetImage() const noexcept {
+        return _image;
+    }
+
 private:
     pntr_image* _image = nullptr;
     pntr_vector _position {};
+    pntr_rectangle _drawnBounds {};
 };
 
 #endif //CART_HPP
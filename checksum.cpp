@@ -0,0 +1,373 @@
+#include "checksum.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__ARM_FEATURE_CRC32) && !defined(__ARM_BIG_ENDIAN)
+#define ROMCLEANER_CHECKSUM_ARM_CRC32
+#include <arm_acle.h>
+#endif
+
+#if defined(__SHA__) && defined(__SSSE3__)
+#define ROMCLEANER_CHECKSUM_SHA_NI
+#include <immintrin.h>
+#elif (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO)) && defined(HAVE_NEON)
+#define ROMCLEANER_CHECKSUM_ARM_SHA1
+#include <arm_neon.h>
+#endif
+
+namespace {
+    constexpr uint32_t CRC_POLYNOMIAL = 0xedb88320;
+
+    // Table s gives the CRC of a byte followed by s zero bytes, so eight bytes can be folded in at once
+    constexpr auto CRC_TABLES = [] {
+        std::array<std::array<uint32_t, 256>, 8> tables {};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ CRC_POLYNOMIAL : crc >> 1;
+            }
+            tables[0][i] = crc;
+        }
+
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (size_t s = 1; s < tables.size(); ++s) {
+                tables[s][i] = (tables[s - 1][i] >> 8) ^ tables[0][tables[s - 1][i] & 0xff];
+            }
+        }
+
+        return tables;
+    }();
+
+    constexpr uint32_t RotateLeft(uint32_t x, int n) noexcept {
+        return (x << n) | (x >> (32 - n));
+    }
+
+    uint32_t LoadLittleEndian(const uint8_t* p) noexcept {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    // a * b modulo the CRC polynomial, both in the reflected bit order
+    uint32_t MultiplyModP(uint32_t a, uint32_t b) noexcept {
+        uint32_t product = 0;
+        for (uint32_t m = 1u << 31; m != 0; m >>= 1) {
+            if (a & m) {
+                product ^= b;
+            }
+            b = (b & 1) ? (b >> 1) ^ CRC_POLYNOMIAL : b >> 1;
+        }
+        return product;
+    }
+
+    // x^(2^n) modulo the CRC polynomial; these repeat every 32 values of n
+    const std::array<uint32_t, 32> X_POW_2N_MOD_P = [] {
+        std::array<uint32_t, 32> table {};
+        uint32_t p = 1u << 30; // x^1
+        for (uint32_t& entry : table) {
+            entry = p;
+            p = MultiplyModP(p, p);
+        }
+        return table;
+    }();
+
+    // Feeds whole 64-byte blocks to compress, buffering whatever's left over for next time
+    template<typename Compress>
+    void BufferedUpdate(std::array<uint8_t, 64>& buffer, uint64_t& length, nonstd::span<const uint8_t> data, Compress compress) noexcept {
+        size_t buffered = length % buffer.size();
+        length += data.size();
+
+        if (buffered > 0) {
+            size_t count = std::min(buffer.size() - buffered, data.size());
+            memcpy(buffer.data() + buffered, data.data(), count);
+            data = data.subspan(count);
+            if (buffered + count < buffer.size())
+                return;
+
+            compress(buffer.data(), 1);
+        }
+
+        size_t blocks = data.size() / buffer.size();
+        if (blocks > 0) {
+            compress(data.data(), blocks);
+            data = data.subspan(blocks * buffer.size());
+        }
+
+        memcpy(buffer.data(), data.data(), data.size());
+    }
+
+    // Appends the 0x80 terminator, zeros and the message's length in bits, as MD5 and SHA-1 both do
+    template<typename Compress>
+    void Pad(std::array<uint8_t, 64>& buffer, uint64_t length, bool bigEndian, Compress compress) noexcept {
+        size_t buffered = length % buffer.size();
+        buffer[buffered++] = 0x80;
+        if (buffered > buffer.size() - 8) {
+            memset(buffer.data() + buffered, 0, buffer.size() - buffered);
+            compress(buffer.data(), 1);
+            buffered = 0;
+        }
+        memset(buffer.data() + buffered, 0, buffer.size() - 8 - buffered);
+
+        uint64_t bits = length * 8;
+        for (size_t i = 0; i < 8; ++i) {
+            size_t shift = bigEndian ? (7 - i) * 8 : i * 8;
+            buffer[buffer.size() - 8 + i] = static_cast<uint8_t>(bits >> shift);
+        }
+        compress(buffer.data(), 1);
+    }
+
+    void Md5Compress(std::array<uint32_t, 4>& state, const uint8_t* blocks, size_t count) noexcept {
+        constexpr std::array<uint32_t, 64> K {
+            0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+            0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+            0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+            0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+            0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+            0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+            0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+            0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+        };
+        constexpr std::array<int, 16> SHIFTS { 7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21 };
+
+        for (size_t block = 0; block < count; ++block, blocks += 64) {
+            std::array<uint32_t, 16> m;
+            for (size_t i = 0; i < m.size(); ++i) {
+                m[i] = LoadLittleEndian(blocks + i * 4);
+            }
+
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+            for (int i = 0; i < 64; ++i) {
+                uint32_t f;
+                int g;
+                switch (i / 16) {
+                    case 0: f = d ^ (b & (c ^ d)); g = i; break;
+                    case 1: f = c ^ (d & (b ^ c)); g = (5 * i + 1) % 16; break;
+                    case 2: f = b ^ c ^ d; g = (3 * i + 5) % 16; break;
+                    default: f = c ^ (b | ~d); g = (7 * i) % 16; break;
+                }
+
+                uint32_t rotated = RotateLeft(a + f + K[i] + m[g], SHIFTS[(i / 16) * 4 + i % 4]);
+                a = d;
+                d = c;
+                c = b;
+                b += rotated;
+            }
+
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+        }
+    }
+
+    constexpr std::array<uint32_t, 4> SHA1_K { 0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6 };
+
+#if defined(ROMCLEANER_CHECKSUM_SHA_NI)
+    void Sha1Compress(std::array<uint32_t, 5>& state, const uint8_t* blocks, size_t count) noexcept {
+        // The instructions want the words in reverse order, A in the top lane
+        const __m128i byteSwap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+        __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state.data())), 0x1b);
+        __m128i e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+
+        for (size_t block = 0; block < count; ++block, blocks += 64) {
+            const __m128i abcdSaved = abcd;
+            const __m128i eSaved = e0;
+
+            // Four rounds per step; w[i % 4] holds the message words for step i
+            __m128i w[4];
+            for (size_t i = 0; i < 4; ++i) {
+                w[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + i * 16)), byteSwap);
+            }
+
+            __m128i e = _mm_add_epi32(e0, w[0]);
+            __m128i previous = abcd;
+            for (int step = 0; step < 20; ++step) {
+                if (step >= 4) {
+                    __m128i& next = w[step % 4];
+                    next = _mm_sha1msg1_epu32(next, w[(step + 1) % 4]);
+                    next = _mm_xor_si128(next, w[(step + 2) % 4]);
+                    next = _mm_sha1msg2_epu32(next, w[(step + 3) % 4]);
+                }
+
+                if (step > 0) {
+                    e = _mm_sha1nexte_epu32(previous, w[step % 4]);
+                }
+
+                previous = abcd;
+                switch (step / 5) {
+                    case 0: abcd = _mm_sha1rnds4_epu32(abcd, e, 0); break;
+                    case 1: abcd = _mm_sha1rnds4_epu32(abcd, e, 1); break;
+                    case 2: abcd = _mm_sha1rnds4_epu32(abcd, e, 2); break;
+                    default: abcd = _mm_sha1rnds4_epu32(abcd, e, 3); break;
+                }
+            }
+
+            e0 = _mm_sha1nexte_epu32(previous, eSaved);
+            abcd = _mm_add_epi32(abcd, abcdSaved);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state.data()), _mm_shuffle_epi32(abcd, 0x1b));
+        alignas(16) std::array<uint32_t, 4> e {};
+        _mm_store_si128(reinterpret_cast<__m128i*>(e.data()), e0);
+        state[4] = e[3];
+    }
+#elif defined(ROMCLEANER_CHECKSUM_ARM_SHA1)
+    void Sha1Compress(std::array<uint32_t, 5>& state, const uint8_t* blocks, size_t count) noexcept {
+        uint32x4_t abcd = vld1q_u32(state.data());
+        uint32_t e0 = state[4];
+
+        for (size_t block = 0; block < count; ++block, blocks += 64) {
+            const uint32x4_t abcdSaved = abcd;
+            const uint32_t eSaved = e0;
+
+            // Four rounds per step; w[i % 4] holds the message words for step i
+            uint32x4_t w[4];
+            for (size_t i = 0; i < 4; ++i) {
+                w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + i * 16)));
+            }
+
+            uint32_t e = e0;
+            for (int step = 0; step < 20; ++step) {
+                if (step >= 4) {
+                    uint32x4_t& next = w[step % 4];
+                    next = vsha1su1q_u32(vsha1su0q_u32(next, w[(step + 1) % 4], w[(step + 2) % 4]), w[(step + 3) % 4]);
+                }
+
+                uint32x4_t wk = vaddq_u32(w[step % 4], vdupq_n_u32(SHA1_K[step / 5]));
+                uint32_t nextE = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+                switch (step / 5) {
+                    case 0: abcd = vsha1cq_u32(abcd, e, wk); break;
+                    case 2: abcd = vsha1mq_u32(abcd, e, wk); break;
+                    default: abcd = vsha1pq_u32(abcd, e, wk); break;
+                }
+                e = nextE;
+            }
+
+            e0 = e + eSaved;
+            abcd = vaddq_u32(abcd, abcdSaved);
+        }
+
+        vst1q_u32(state.data(), abcd);
+        state[4] = e0;
+    }
+#else
+    uint32_t LoadBigEndian(const uint8_t* p) noexcept {
+        return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    }
+
+    void Sha1Compress(std::array<uint32_t, 5>& state, const uint8_t* blocks, size_t count) noexcept {
+        for (size_t block = 0; block < count; ++block, blocks += 64) {
+            // Only the last 16 words of the schedule are needed at any one time
+            std::array<uint32_t, 16> w;
+            for (size_t i = 0; i < w.size(); ++i) {
+                w[i] = LoadBigEndian(blocks + i * 4);
+            }
+
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+            for (int i = 0; i < 80; ++i) {
+                if (i >= 16) {
+                    w[i % 16] = RotateLeft(w[(i + 13) % 16] ^ w[(i + 8) % 16] ^ w[(i + 2) % 16] ^ w[i % 16], 1);
+                }
+
+                uint32_t f;
+                switch (i / 20) {
+                    case 0: f = d ^ (b & (c ^ d)); break;
+                    case 2: f = (b & c) | (d & (b | c)); break;
+                    default: f = b ^ c ^ d; break;
+                }
+
+                uint32_t temp = RotateLeft(a, 5) + f + e + SHA1_K[i / 20] + w[i % 16];
+                e = d;
+                d = c;
+                c = RotateLeft(b, 30);
+                b = a;
+                a = temp;
+            }
+
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+        }
+    }
+#endif
+}
+
+uint32_t Crc32Update(uint32_t crc, nonstd::span<const uint8_t> data) noexcept {
+    const uint8_t* p = data.data();
+    size_t length = data.size();
+    crc = ~crc;
+
+#if defined(ROMCLEANER_CHECKSUM_ARM_CRC32)
+    for (; length >= 8; p += 8, length -= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc = __crc32d(crc, word);
+    }
+#else
+    // Slicing-by-8; x86's CRC32 instruction uses a different polynomial, so it's no help here
+    for (; length >= 8; p += 8, length -= 8) {
+        uint32_t low = LoadLittleEndian(p) ^ crc;
+        uint32_t high = LoadLittleEndian(p + 4);
+        crc = CRC_TABLES[7][low & 0xff] ^ CRC_TABLES[6][(low >> 8) & 0xff] ^
+              CRC_TABLES[5][(low >> 16) & 0xff] ^ CRC_TABLES[4][low >> 24] ^
+              CRC_TABLES[3][high & 0xff] ^ CRC_TABLES[2][(high >> 8) & 0xff] ^
+              CRC_TABLES[1][(high >> 16) & 0xff] ^ CRC_TABLES[0][high >> 24];
+    }
+#endif
+
+    for (; length > 0; ++p, --length) {
+        crc = CRC_TABLES[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+uint32_t Crc32Combine(uint32_t first, uint32_t second, uint64_t secondLength) noexcept {
+    // Shifting the first CRC past secondLength zero bytes multiplies it by x^(8 * secondLength)
+    uint32_t shift = 1u << 31; // x^0
+    uint64_t n = secondLength;
+    for (size_t k = 3; n != 0; n >>= 1, ++k) {
+        if (n & 1) {
+            shift = MultiplyModP(X_POW_2N_MOD_P[k % X_POW_2N_MOD_P.size()], shift);
+        }
+    }
+
+    return MultiplyModP(shift, first) ^ second;
+}
+
+void Md5::Update(nonstd::span<const uint8_t> data) noexcept {
+    BufferedUpdate(_buffer, _length, data, [this](const uint8_t* blocks, size_t count) noexcept {
+        Md5Compress(_state, blocks, count);
+    });
+}
+
+Md5Digest Md5::Finish() noexcept {
+    Pad(_buffer, _length, false, [this](const uint8_t* blocks, size_t count) noexcept {
+        Md5Compress(_state, blocks, count);
+    });
+
+    Md5Digest digest;
+    for (size_t i = 0; i < digest.size(); ++i) {
+        digest[i] = static_cast<uint8_t>(_state[i / 4] >> ((i % 4) * 8));
+    }
+    return digest;
+}
+
+void Sha1::Update(nonstd::span<const uint8_t> data) noexcept {
+    BufferedUpdate(_buffer, _length, data, [this](const uint8_t* blocks, size_t count) noexcept {
+        Sha1Compress(_state, blocks, count);
+    });
+}
+
+Sha1Digest Sha1::Finish() noexcept {
+    Pad(_buffer, _length, true, [this](const uint8_t* blocks, size_t count) noexcept {
+        Sha1Compress(_state, blocks, count);
+    });
+
+    Sha1Digest digest;
+    for (size_t i = 0; i < digest.size(); ++i) {
+        digest[i] = static_cast<uint8_t>(_state[i / 4] >> ((3 - i % 4) * 8));
+    }
+    return digest;
+}
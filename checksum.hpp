@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <nonstd/span.hpp>
+
+// The CRC-32 used by zip, PNG and every ROM database (polynomial 0xEDB88320, reflected).
+// Start with 0 and feed each piece of the data in order.
+[[nodiscard]] uint32_t Crc32Update(uint32_t crc, nonstd::span<const uint8_t> data) noexcept;
+
+// The CRC-32 of two pieces of data laid end to end, given each piece's CRC-32 and the second one's length.
+// Lets separate threads work on separate pieces.
+[[nodiscard]] uint32_t Crc32Combine(uint32_t first, uint32_t second, uint64_t secondLength) noexcept;
+
+using Md5Digest = std::array<uint8_t, 16>;
+using Sha1Digest = std::array<uint8_t, 20>;
+
+// Formats a digest as null-terminated lowercase hex, the way DAT files and most tools print them
+template<size_t N>
+[[nodiscard]] std::array<char, N * 2 + 1> ToHex(const std::array<uint8_t, N>& digest) noexcept {
+    constexpr char DIGITS[] = "0123456789abcdef";
+    std::array<char, N * 2 + 1> hex {};
+    for (size_t i = 0; i < N; ++i) {
+        hex[i * 2] = DIGITS[digest[i] >> 4];
+        hex[i * 2 + 1] = DIGITS[digest[i] & 0xf];
+    }
+    return hex;
+}
+
+class Md5 {
+public:
+    void Update(nonstd::span<const uint8_t> data) noexcept;
+
+    // Pads out the message and returns the digest; call Reset before reusing the hasher.
+    [[nodiscard]] Md5Digest Finish() noexcept;
+    void Reset() noexcept { *this = Md5(); }
+
+private:
+    std::array<uint32_t, 4> _state { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    std::array<uint8_t, 64> _buffer {};
+    uint64_t _length = 0; // In bytes
+};
+
+// Uses the CPU's SHA-1 instructions where the build targets them.
+class Sha1 {
+public:
+    void Update(nonstd::span<const uint8_t> data) noexcept;
+
+    // Pads out the message and returns the digest; call Reset before reusing the hasher.
+    [[nodiscard]] Sha1Digest Finish() noexcept;
+    void Reset() noexcept { *this = Sha1(); }
+
+private:
+    std::array<uint32_t, 5> _state { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+    std::array<uint8_t, 64> _buffer {};
+    uint64_t _length = 0; // In bytes
+};
@@ -7,8 +7,13 @@ option(ENABLE_DYNAMIC "Build with dynamic library support, if supported by the t
 option(ENABLE_EGL "Build with EGL support, if supported by the target." OFF)
 option(ENABLE_NETWORKING "Build with networking support, if supported by the target." ON)
 option(ENABLE_SCCACHE "Build with sccache instead of ccache, if available." OFF)
-option(ENABLE_ZLIB "Build with zlib support, if supported by the target." OFF)
+option(ENABLE_ZLIB "Build with zlib support, so zipped ROMs can be read without being extracted first." ON)
 option(ENABLE_GLSM_DEBUG "Enable debug output for GLSM." OFF)
+option(ENABLE_TOOLS "Build the standalone benchmark tools for the host." OFF)
+option(ENABLE_BAKED_SPRITES "Decode sprites at build time instead of when the core loads, unless cross-compiling." ON)
+option(ENABLE_THREADS "Build with threading support, if supported by the target." ON)
+option(ENABLE_PROFILER "Build with the per-phase frame profiler and its on-screen overlay." OFF)
+option(ENABLE_ALLOCATION_AUDIT "Count heap allocations in retro_run and assert that there are none. For debugging." OFF)
 
 if (ENABLE_SCCACHE)
     find_program(SCCACHE "sccache" PATHS "$ENV{HOME}/.cargo/bin")
@@ -23,6 +28,10 @@ endif ()
 
 include(CheckIncludeFile)
 
+if (ENABLE_THREADS)
+    find_package(Threads)
+endif ()
+
 if (Threads_FOUND)
     set(HAVE_THREADS ON)
 endif ()
@@ -31,10 +40,23 @@ if (ENABLE_ZLIB)
     set(HAVE_ZLIB ON)
 endif ()
 
+if (ENABLE_BAKED_SPRITES AND NOT CMAKE_CROSSCOMPILING)
+    # The sprite baker runs during the build, so it must be able to run on the build machine
+    set(HAVE_BAKED_SPRITES ON)
+endif ()
+
 if (ENABLE_GLSM_DEBUG)
     set(HAVE_GLSM_DEBUG ON)
 endif ()
 
+if (ENABLE_PROFILER)
+    set(HAVE_PROFILER ON)
+endif ()
+
+if (ENABLE_ALLOCATION_AUDIT)
+    set(HAVE_ALLOCATION_AUDIT ON)
+endif ()
+
 if (ENABLE_OPENGL)
     # ENABLE_OGLRENDERER is defined by melonDS's CMakeLists.txt
     if (OPENGL_PROFILE STREQUAL "OpenGL")
@@ -160,6 +182,10 @@ function(add_common_definitions TARGET)
         target_compile_definitions(${TARGET} PUBLIC HAVE_NEON)
     endif ()
 
+    if (HAVE_ALLOCATION_AUDIT)
+        target_compile_definitions(${TARGET} PUBLIC HAVE_ALLOCATION_AUDIT)
+    endif ()
+
     if (HAVE_ARM_NEON_ASM_OPTIMIZATIONS)
         target_compile_definitions(${TARGET} PUBLIC HAVE_ARM_NEON_ASM_OPTIMIZATIONS)
     endif ()
@@ -236,6 +262,10 @@ function(add_common_definitions TARGET)
         target_compile_definitions(${TARGET} PUBLIC HAVE_OPENGLES32 HAVE_OPENGLES_32 HAVE_OPENGLES_3_2)
     endif ()
 
+    if (HAVE_PROFILER)
+        target_compile_definitions(${TARGET} PUBLIC HAVE_PROFILER)
+    endif ()
+
     if (HAVE_STRL)
         target_compile_definitions(${TARGET} PUBLIC HAVE_STRL)
     endif ()
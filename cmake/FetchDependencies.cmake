@@ -45,3 +45,8 @@ fetch_dependency(kissfft "https://github.com/mborgerding/kissfft" "febd4ca")
 fetch_dependency(span-lite "https://github.com/martinmoene/span-lite" "00afc28")
 
 FetchContent_MakeAvailable(libretro-common pntr embed-binaries kissfft span-lite)
+
+if (ENABLE_ZLIB)
+    fetch_dependency(zlib "https://github.com/madler/zlib" "v1.3.1")
+    FetchContent_MakeAvailable(zlib)
+endif ()
@@ -129,6 +129,7 @@ if (HAVE_THREADS)
     target_sources(libretro-common PRIVATE
         ${libretro-common_SOURCE_DIR}/rthreads/rthreads.c
         )
+    target_link_libraries(libretro-common PUBLIC Threads::Threads)
 endif ()
 
 if (HAVE_ZLIB)
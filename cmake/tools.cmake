@@ -0,0 +1,43 @@
+# Standalone executables for measuring the core outside of a frontend.
+# They're built for the host, so they're off by default (and pointless when cross-compiling).
+
+function(add_romcleaner_tool TARGET)
+    add_executable(${TARGET} ${ARGN})
+    add_common_definitions(${TARGET})
+
+    target_include_directories(${TARGET} PRIVATE
+        "${CMAKE_CURRENT_SOURCE_DIR}"
+        "${CMAKE_CURRENT_SOURCE_DIR}/tools"
+    )
+
+    target_include_directories(${TARGET} SYSTEM PRIVATE
+        "${libretro-common_SOURCE_DIR}/include"
+        "${kissfft_SOURCE_DIR}/include"
+        "${span-lite_SOURCE_DIR}/include"
+    )
+
+    target_link_libraries(${TARGET} PRIVATE libretro-common libretro-assets kissfft)
+endfunction()
+
+add_romcleaner_tool(romcleaner_blowbench
+    tools/blowbench.cpp
+    tools/corpus.cpp
+    tools/corpus.hpp
+    blow.cpp
+    blow.hpp
+    profiler.cpp
+    profiler.hpp
+)
+
+# The headless host loads the core at runtime, so it only makes sense where shared libraries do
+if (UNIX AND HAVE_DYNAMIC)
+    add_romcleaner_tool(romcleaner_headless
+        tools/headless.cpp
+        tools/corpus.cpp
+        tools/corpus.hpp
+    )
+    target_link_libraries(romcleaner_headless PRIVATE ${CMAKE_DL_LIBS})
+
+    # Not linked, but there's nothing to drive without it
+    add_dependencies(romcleaner_headless romcleaner_libretro)
+endif ()
@@ -1,8 +1,14 @@
 #pragma once
 
 constexpr int SAMPLE_RATE = 44100;
+// The native resolution, and the largest the core will render at; see RenderResolution
 constexpr int SCREEN_WIDTH = 1366;
 constexpr int SCREEN_HEIGHT = 768;
+// The simulation always advances in steps this long, however often the frontend runs the core
+constexpr double SIMULATION_RATE = 60.0;
+constexpr double TIME_STEP = 1.0f / SIMULATION_RATE;
+// The frame rates the core can ask the frontend for; see OPTION_FRAME_RATE
 constexpr double FPS = 60.0;
+constexpr double MIN_FPS = 30.0;
 constexpr int SAMPLES_PER_FRAME = SAMPLE_RATE / FPS;
-constexpr double TIME_STEP = 1.0f / FPS;
\ No newline at end of file
+constexpr int MAX_SAMPLES_PER_FRAME = SAMPLE_RATE / MIN_FPS;
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "damage.hpp"
+
+#include <algorithm>
+
+pntr_rectangle RectUnion(pntr_rectangle a, pntr_rectangle b) noexcept {
+    if (RectIsEmpty(a)) return b;
+    if (RectIsEmpty(b)) return a;
+
+    int left = std::min(a.x, b.x);
+    int top = std::min(a.y, b.y);
+    int right = std::max(a.x + a.width, b.x + b.width);
+    int bottom = std::max(a.y + a.height, b.y + b.height);
+
+    return { left, top, right - left, bottom - top };
+}
+
+pntr_rectangle RectIntersection(pntr_rectangle a, pntr_rectangle b) noexcept {
+    int left = std::max(a.x, b.x);
+    int top = std::max(a.y, b.y);
+    int right = std::min(a.x + a.width, b.x + b.width);
+    int bottom = std::min(a.y + a.height, b.y + b.height);
+
+    if (right <= left || bottom <= top) {
+        return { 0, 0, 0, 0 };
+    }
+
+    return { left, top, right - left, bottom - top };
+}
+
+void DrawImageClipped(pntr_image& dst, pntr_image* src, int x, int y, pntr_rectangle clip) noexcept {
+    pntr_rectangle visible = RectIntersection({ x, y, src->width, src->height }, clip);
+    if (RectIsEmpty(visible))
+        return;
+
+    pntr_rectangle srcRect = { visible.x - x, visible.y - y, visible.width, visible.height };
+    pntr_draw_image_rec(&dst, src, srcRect, visible.x, visible.y);
+}
+
+void DamageTracker::Add(pntr_rectangle rect) noexcept {
+    rect = RectIntersection(rect, _screen);
+    if (RectIsEmpty(rect))
+        return;
+
+    // Absorb every existing region that overlaps the new one;
+    // the grown rectangle may now overlap regions it didn't before, so repeat until stable.
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < _count; ++i) {
+            if (!RectIsEmpty(RectIntersection(rect, _regions[i]))) {
+                rect = RectUnion(rect, _regions[i]);
+                _regions[i] = _regions[--_count];
+                merged = true;
+                break;
+            }
+        }
+    }
+
+    if (_count == MAX_REGIONS) {
+        for (size_t i = 0; i < _count; ++i) {
+            rect = RectUnion(rect, _regions[i]);
+        }
+        _count = 0;
+    }
+
+    _regions[_count++] = rect;
+}
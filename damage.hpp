@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <pntr.h>
+
+#include <nonstd/span.hpp>
+
+[[nodiscard]] constexpr bool RectIsEmpty(pntr_rectangle rect) noexcept {
+    return rect.width <= 0 || rect.height <= 0;
+}
+
+[[nodiscard]] constexpr bool RectEquals(pntr_rectangle a, pntr_rectangle b) noexcept {
+    return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+[[nodiscard]] pntr_rectangle RectUnion(pntr_rectangle a, pntr_rectangle b) noexcept;
+[[nodiscard]] pntr_rectangle RectIntersection(pntr_rectangle a, pntr_rectangle b) noexcept;
+
+// Draws the part of src (placed at x, y) that falls within clip.
+void DrawImageClipped(pntr_image& dst, pntr_image* src, int x, int y, pntr_rectangle clip) noexcept;
+
+// Collects the screen regions that changed since the last presented frame.
+// Overlapping regions are merged so that the final set is disjoint;
+// this way each pixel is restored and blended exactly once per frame.
+class DamageTracker {
+public:
+    // Past this many regions the bookkeeping costs more than it saves,
+    // so everything is collapsed into one bounding box.
+    static constexpr size_t MAX_REGIONS = 8;
+
+    DamageTracker(int width, int height) noexcept : _screen {0, 0, width, height} {}
+
+    void Add(pntr_rectangle rect) noexcept;
+    void AddAll() noexcept { Add(_screen); }
+    void Clear() noexcept { _count = 0; }
+
+    [[nodiscard]] bool IsEmpty() const noexcept { return _count == 0; }
+    [[nodiscard]] nonstd::span<const pntr_rectangle> GetRegions() const noexcept {
+        return {_regions.data(), _count};
+    }
+
+private:
+    std::array<pntr_rectangle, MAX_REGIONS> _regions {};
+    size_t _count = 0;
+    pntr_rectangle _screen;
+};
@@ -0,0 +1,508 @@
+#include "dat_index.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include <file/file_path.h>
+#include <lists/dir_list.h>
+#include <streams/file_stream.h>
+
+using std::string_view;
+
+namespace {
+    constexpr char INDEX_MAGIC[8] = { 'R', 'C', 'D', 'A', 'T', 'I', 'D', 'X' };
+
+    // Written as a native integer, so an index copied from a machine with the other byte order reads back wrong and is rebuilt
+    constexpr uint32_t INDEX_BYTE_ORDER = 0x01020304;
+
+    // Offset 0 in the string table is always the empty string
+    constexpr uint32_t EMPTY_STRING = 0;
+
+    struct DatIndexHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t sourceStamp; // Identifies the DATs the index was built from
+        uint32_t datCount;
+        uint32_t recordCount; // Followed by this many DatRecords...
+        uint32_t sha1Count;   // ...then this many record indexes...
+        uint32_t stringsSize; // ...then this many bytes of null-terminated strings
+    };
+    static_assert(sizeof(DatIndexHeader) % alignof(DatRecord) == 0, "The records have to be aligned in the index file");
+
+    struct DatIndexBuilder {
+        std::vector<DatRecord> records;
+        std::vector<char> strings { '\0' };
+
+        // Decodes the XML entities in text on the way in
+        uint32_t AddString(string_view text);
+    };
+
+    bool IsSpace(char c) noexcept {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    string_view Trim(string_view text) noexcept {
+        while (!text.empty() && IsSpace(text.front()))
+            text.remove_prefix(1);
+        while (!text.empty() && IsSpace(text.back()))
+            text.remove_suffix(1);
+        return text;
+    }
+
+    void AppendUtf8(std::vector<char>& out, uint32_t codepoint) {
+        if (codepoint < 0x80) {
+            out.push_back(static_cast<char>(codepoint));
+        } else if (codepoint < 0x800) {
+            out.push_back(static_cast<char>(0xc0 | (codepoint >> 6)));
+            out.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+        } else if (codepoint < 0x10000) {
+            out.push_back(static_cast<char>(0xe0 | (codepoint >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+        } else if (codepoint < 0x110000) {
+            out.push_back(static_cast<char>(0xf0 | (codepoint >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+        }
+    }
+
+    // Returns false (and leaves codepoint alone) if entity isn't one of XML's predefined or numeric entities
+    bool DecodeEntity(string_view entity, uint32_t& codepoint) noexcept {
+        if (entity == "amp") codepoint = '&';
+        else if (entity == "lt") codepoint = '<';
+        else if (entity == "gt") codepoint = '>';
+        else if (entity == "quot") codepoint = '"';
+        else if (entity == "apos") codepoint = '\'';
+        else if (entity.size() > 1 && entity[0] == '#') {
+            bool hex = entity[1] == 'x' || entity[1] == 'X';
+            string_view digits = entity.substr(hex ? 2 : 1);
+            if (digits.empty() || digits.size() > 8)
+                return false;
+
+            uint32_t value = 0;
+            for (char c : digits) {
+                uint32_t digit;
+                if (c >= '0' && c <= '9') digit = c - '0';
+                else if (hex && c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+                else if (hex && c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+                else return false;
+                value = value * (hex ? 16 : 10) + digit;
+            }
+            codepoint = value;
+        }
+        else return false;
+
+        return true;
+    }
+
+    uint32_t DatIndexBuilder::AddString(string_view text) {
+        text = Trim(text);
+        if (text.empty())
+            return EMPTY_STRING;
+
+        auto offset = static_cast<uint32_t>(strings.size());
+        while (!text.empty()) {
+            size_t amp = text.find('&');
+            strings.insert(strings.end(), text.begin(), text.begin() + std::min(amp, text.size()));
+            if (amp == string_view::npos)
+                break;
+
+            size_t semicolon = text.find(';', amp);
+            uint32_t codepoint = 0;
+            if (semicolon != string_view::npos && DecodeEntity(text.substr(amp + 1, semicolon - amp - 1), codepoint)) {
+                AppendUtf8(strings, codepoint);
+                text.remove_prefix(semicolon + 1);
+            } else {
+                strings.push_back('&');
+                text.remove_prefix(amp + 1);
+            }
+        }
+        strings.push_back('\0');
+        return offset;
+    }
+
+    // Returns the value of the named attribute (still XML-escaped), or an empty view if it isn't there
+    string_view GetAttribute(string_view attributes, string_view key) noexcept {
+        size_t position = 0;
+        while (position < attributes.size()) {
+            size_t equals = attributes.find('=', position);
+            if (equals == string_view::npos)
+                break;
+
+            size_t quote = attributes.find_first_of("\"'", equals + 1);
+            if (quote == string_view::npos)
+                break;
+
+            size_t close = attributes.find(attributes[quote], quote + 1);
+            if (close == string_view::npos)
+                break;
+
+            if (Trim(attributes.substr(position, equals - position)) == key)
+                return attributes.substr(quote + 1, close - quote - 1);
+
+            position = close + 1;
+        }
+
+        return {};
+    }
+
+    // Parses exactly out.size() bytes' worth of hex digits
+    bool ParseHex(string_view text, nonstd::span<uint8_t> out) noexcept {
+        text = Trim(text);
+        if (text.size() != out.size() * 2)
+            return false;
+
+        for (size_t i = 0; i < text.size(); ++i) {
+            char c = text[i];
+            uint8_t digit;
+            if (c >= '0' && c <= '9') digit = c - '0';
+            else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+            else return false;
+
+            out[i / 2] = (i % 2 == 0) ? static_cast<uint8_t>(digit << 4) : static_cast<uint8_t>(out[i / 2] | digit);
+        }
+
+        return true;
+    }
+
+    bool ParseSize(string_view text, uint64_t& size) noexcept {
+        text = Trim(text);
+        if (text.empty() || text.size() > 19)
+            return false;
+
+        size = 0;
+        for (char c : text) {
+            if (c < '0' || c > '9')
+                return false;
+            size = size * 10 + (c - '0');
+        }
+        return true;
+    }
+
+    // Finds the '>' that ends the tag starting at position, skipping any inside quoted attribute values
+    size_t FindTagEnd(string_view text, size_t position) noexcept {
+        char quote = '\0';
+        for (size_t i = position; i < text.size(); ++i) {
+            char c = text[i];
+            if (quote) {
+                if (c == quote)
+                    quote = '\0';
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            } else if (c == '>') {
+                return i;
+            }
+        }
+        return string_view::npos;
+    }
+
+    // Pulls every <rom> out of a Logiqx XML DAT.
+    // This isn't a general XML parser, just a scan for the handful of elements a DAT's ROMs are described with,
+    // which is much faster than building a DOM of a file with tens of thousands of games.
+    void ParseDat(string_view text, string_view fileName, DatIndexBuilder& builder) {
+        constexpr uint32_t NO_DAT_NAME = UINT32_MAX;
+        uint32_t dat = NO_DAT_NAME;
+        uint32_t game = EMPTY_STRING;
+        bool inHeader = false;
+        bool inGame = false;
+
+        size_t position = 0;
+        while ((position = text.find('<', position)) != string_view::npos) {
+            if (text.compare(position, 4, "<!--") == 0) {
+                size_t end = text.find("-->", position + 4);
+                position = (end == string_view::npos) ? text.size() : end + 3;
+                continue;
+            }
+
+            size_t end = FindTagEnd(text, position + 1);
+            if (end == string_view::npos)
+                break;
+
+            string_view tag = text.substr(position + 1, end - position - 1);
+            position = end + 1;
+
+            // The XML declaration and the DOCTYPE
+            if (tag.empty() || tag[0] == '?' || tag[0] == '!')
+                continue;
+
+            bool closing = tag[0] == '/';
+            if (closing)
+                tag.remove_prefix(1);
+
+            size_t nameEnd = std::min(tag.find_first_of(" \t\r\n/"), tag.size());
+            string_view name = tag.substr(0, nameEnd);
+            string_view attributes = tag.substr(nameEnd);
+            bool isGame = name == "game" || name == "machine";
+
+            if (closing) {
+                if (name == "header") inHeader = false;
+                else if (isGame) inGame = false;
+                continue;
+            }
+
+            if (name == "header") {
+                inHeader = true;
+            } else if (inHeader && name == "name" && dat == NO_DAT_NAME) {
+                size_t textEnd = text.find('<', position);
+                dat = builder.AddString(text.substr(position, std::min(textEnd, text.size()) - position));
+            } else if (isGame) {
+                game = builder.AddString(GetAttribute(attributes, "name"));
+                inGame = attributes.empty() || attributes.back() != '/';
+            } else if (inGame && name == "rom") {
+                DatRecord record {};
+                uint8_t crc[4] {};
+                if (ParseHex(GetAttribute(attributes, "crc"), crc)) {
+                    record.crc32 = (uint32_t(crc[0]) << 24) | (uint32_t(crc[1]) << 16) | (uint32_t(crc[2]) << 8) | crc[3];
+                    record.flags |= DAT_RECORD_HAS_CRC32;
+                }
+                if (ParseHex(GetAttribute(attributes, "md5"), record.md5))
+                    record.flags |= DAT_RECORD_HAS_MD5;
+                if (ParseHex(GetAttribute(attributes, "sha1"), record.sha1))
+                    record.flags |= DAT_RECORD_HAS_SHA1;
+
+                // Without a size a CRC-32 alone is too weak to go on, and without any hash there's nothing to go on at all
+                bool hasSize = ParseSize(GetAttribute(attributes, "size"), record.size);
+                if (!hasSize)
+                    record.size = 0;
+                if (!(record.flags & DAT_RECORD_HAS_SHA1) && !(hasSize && (record.flags & DAT_RECORD_HAS_CRC32)))
+                    continue;
+
+                if (dat == NO_DAT_NAME)
+                    dat = builder.AddString(fileName);
+
+                record.game = game;
+                record.rom = builder.AddString(GetAttribute(attributes, "name"));
+                record.dat = dat;
+                builder.records.push_back(record);
+            }
+        }
+    }
+
+    std::vector<std::string> ListDats(const char* directory) {
+        std::vector<std::string> dats;
+        if (!directory)
+            return dats;
+
+        string_list* list = dir_list_new(directory, "dat|xml", false, false, false, false);
+        if (!list)
+            return dats;
+
+        // Sorted, so that the stamp (and the index) doesn't depend on the order the filesystem lists them in
+        dir_list_sort(list, false);
+        for (size_t i = 0; i < list->size; ++i) {
+            dats.emplace_back(list->elems[i].data);
+        }
+        dir_list_free(list);
+        return dats;
+    }
+
+    // A 64-bit FNV-1a hash of each DAT's name, size and modification time.
+    // If it doesn't match the one in the index, the index is rebuilt.
+    uint64_t GetSourceStamp(const std::vector<std::string>& dats) noexcept {
+        uint64_t stamp = 0xcbf29ce484222325ull;
+        auto mix = [&stamp](const void* data, size_t size) noexcept {
+            const auto* bytes = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; ++i) {
+                stamp = (stamp ^ bytes[i]) * 0x100000001b3ull;
+            }
+        };
+
+        mix(&DAT_INDEX_VERSION, sizeof(DAT_INDEX_VERSION));
+        for (const std::string& path : dats) {
+            FileStamp file {};
+            if (!GetFileStamp(path.c_str(), file))
+                continue;
+
+            const char* name = path_basename(path.c_str());
+            mix(name, strlen(name) + 1);
+            mix(&file.size, sizeof(file.size));
+            mix(&file.modified, sizeof(file.modified));
+        }
+        return stamp;
+    }
+
+    std::vector<uint8_t> BuildIndex(const std::vector<std::string>& dats, uint64_t sourceStamp) {
+        DatIndexBuilder builder;
+        for (const std::string& path : dats) {
+            void* text = nullptr;
+            int64_t length = 0;
+            if (!filestream_read_file(path.c_str(), &text, &length) || !text)
+                continue;
+
+            ParseDat(string_view(static_cast<const char*>(text), static_cast<size_t>(length)), path_basename(path.c_str()), builder);
+            free(text);
+        }
+
+        std::vector<DatRecord>& records = builder.records;
+        std::sort(records.begin(), records.end(), [](const DatRecord& a, const DatRecord& b) noexcept {
+            return a.crc32 != b.crc32 ? a.crc32 < b.crc32 : a.size < b.size;
+        });
+
+        std::vector<uint32_t> sha1Order;
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (records[i].flags & DAT_RECORD_HAS_SHA1)
+                sha1Order.push_back(static_cast<uint32_t>(i));
+        }
+        std::sort(sha1Order.begin(), sha1Order.end(), [&records](uint32_t a, uint32_t b) noexcept {
+            return memcmp(records[a].sha1, records[b].sha1, sizeof(DatRecord::sha1)) < 0;
+        });
+
+        DatIndexHeader header {};
+        memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        header.version = DAT_INDEX_VERSION;
+        header.byteOrder = INDEX_BYTE_ORDER;
+        header.sourceStamp = sourceStamp;
+        header.datCount = static_cast<uint32_t>(dats.size());
+        header.recordCount = static_cast<uint32_t>(records.size());
+        header.sha1Count = static_cast<uint32_t>(sha1Order.size());
+        header.stringsSize = static_cast<uint32_t>(builder.strings.size());
+
+        size_t recordsSize = records.size() * sizeof(DatRecord);
+        size_t sha1OrderSize = sha1Order.size() * sizeof(uint32_t);
+        std::vector<uint8_t> index(sizeof(header) + recordsSize + sha1OrderSize + builder.strings.size());
+        uint8_t* out = index.data();
+        memcpy(out, &header, sizeof(header));
+        out += sizeof(header);
+        memcpy(out, records.data(), recordsSize);
+        out += recordsSize;
+        memcpy(out, sha1Order.data(), sha1OrderSize);
+        out += sha1OrderSize;
+        memcpy(out, builder.strings.data(), builder.strings.size());
+        return index;
+    }
+}
+
+bool DatIndex::Open(const char* datDirectory, const char* indexPath) {
+    Close();
+
+    std::vector<std::string> dats = ListDats(datDirectory);
+    if (dats.empty())
+        return false;
+
+    _datCount = dats.size();
+    uint64_t sourceStamp = GetSourceStamp(dats);
+    if (indexPath && _file.Open(indexPath, RomFile::Access::Random)) {
+        if (_file.IsMapped()) {
+            if (Load(_file.GetMapping(), sourceStamp))
+                return true;
+        } else {
+            _storage.resize(static_cast<size_t>(_file.GetSize()));
+            size_t read = 0;
+            while (read < _storage.size()) {
+                nonstd::span<const uint8_t> bytes = _file.Read(_storage.size() - read, _storage.data() + read);
+                if (bytes.empty())
+                    break;
+                read += bytes.size();
+            }
+
+            if (read == _storage.size() && Load(_storage, sourceStamp))
+                return true;
+        }
+        _file.Close();
+    }
+
+    _storage = BuildIndex(dats, sourceStamp);
+    _rebuilt = true;
+
+    // If the index can't be saved, it's rebuilt next session too; slower, but nothing's lost
+    if (indexPath) {
+        filestream_write_file(indexPath, _storage.data(), static_cast<int64_t>(_storage.size()));
+    }
+
+    return Load(_storage, sourceStamp);
+}
+
+void DatIndex::Close() noexcept {
+    _records = {};
+    _sha1Order = {};
+    _strings = {};
+    _file.Close();
+    _storage = {};
+    _datCount = 0;
+    _rebuilt = false;
+}
+
+// Only the header's checked here, so that opening the index doesn't touch every page of it;
+// the offsets and indexes inside it are checked as they're used
+bool DatIndex::Load(nonstd::span<const uint8_t> index, uint64_t sourceStamp) noexcept {
+    DatIndexHeader header {};
+    if (index.size() < sizeof(header))
+        return false;
+
+    memcpy(&header, index.data(), sizeof(header));
+    if (memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header.version != DAT_INDEX_VERSION ||
+        header.byteOrder != INDEX_BYTE_ORDER || header.sourceStamp != sourceStamp)
+        return false;
+
+    uint64_t recordsSize = uint64_t(header.recordCount) * sizeof(DatRecord);
+    uint64_t sha1OrderSize = uint64_t(header.sha1Count) * sizeof(uint32_t);
+    if (header.recordCount == 0 || header.sha1Count > header.recordCount || header.stringsSize == 0 ||
+        sizeof(header) + recordsSize + sha1OrderSize + header.stringsSize != index.size())
+        return false;
+
+    const uint8_t* data = index.data() + sizeof(header);
+    const char* strings = reinterpret_cast<const char*>(data + recordsSize + sha1OrderSize);
+    if (strings[0] != '\0' || strings[header.stringsSize - 1] != '\0')
+        return false;
+
+    _records = { reinterpret_cast<const DatRecord*>(data), header.recordCount };
+    _sha1Order = { reinterpret_cast<const uint32_t*>(data + recordsSize), header.sha1Count };
+    _strings = { strings, header.stringsSize };
+    return true;
+}
+
+const char* DatIndex::GetString(uint32_t offset) const noexcept {
+    // The table starts and ends with a null terminator, so every offset inside it lands on a terminated string
+    return offset < _strings.size() ? _strings.data() + offset : _strings.data();
+}
+
+bool DatIndex::Find(const RomHashes& hashes, DatMatch& match) const noexcept {
+    if (!IsOpen())
+        return false;
+
+    auto found = [&](const DatRecord& record, bool bySha1) noexcept {
+        match.game = GetString(record.game);
+        match.rom = GetString(record.rom);
+        match.dat = GetString(record.dat);
+        match.bySha1 = bySha1;
+        return true;
+    };
+
+    // SHA-1 first; it's what No-Intro and Redump identify dumps by
+    auto sha1Less = [this](uint32_t record, const Sha1Digest& sha1) noexcept {
+        return record < _records.size() && memcmp(_records[record].sha1, sha1.data(), sha1.size()) < 0;
+    };
+    auto bySha1 = std::lower_bound(_sha1Order.begin(), _sha1Order.end(), hashes.sha1, sha1Less);
+    if (bySha1 != _sha1Order.end() && *bySha1 < _records.size()) {
+        const DatRecord& record = _records[*bySha1];
+        if (memcmp(record.sha1, hashes.sha1.data(), hashes.sha1.size()) == 0)
+            return found(record, true);
+    }
+
+    // Older DATs only have CRC-32s, which are only trusted alongside the size
+    auto crcLess = [](const DatRecord& record, const RomHashes& key) noexcept {
+        return record.crc32 != key.crc32 ? record.crc32 < key.crc32 : record.size < key.size;
+    };
+    for (auto byCrc = std::lower_bound(_records.begin(), _records.end(), hashes, crcLess);
+         byCrc != _records.end() && byCrc->crc32 == hashes.crc32 && byCrc->size == hashes.size; ++byCrc) {
+        const DatRecord& record = *byCrc;
+        if (!(record.flags & DAT_RECORD_HAS_CRC32))
+            continue;
+
+        // A record with a different SHA-1 (which the search above would've found) or MD5 is a CRC-32 collision
+        if (record.flags & DAT_RECORD_HAS_SHA1)
+            continue;
+        if ((record.flags & DAT_RECORD_HAS_MD5) && memcmp(record.md5, hashes.md5.data(), hashes.md5.size()) != 0)
+            continue;
+
+        return found(record, false);
+    }
+
+    return false;
+}
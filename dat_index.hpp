@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <nonstd/span.hpp>
+
+#include "rom_file.hpp"
+#include "rom_hasher.hpp"
+
+// Bump whenever the index's layout changes; older indexes are rebuilt from the DATs
+constexpr uint32_t DAT_INDEX_VERSION = 1;
+
+enum DatRecordFlags : uint32_t {
+    DAT_RECORD_HAS_CRC32 = 1 << 0,
+    DAT_RECORD_HAS_MD5 = 1 << 1,
+    DAT_RECORD_HAS_SHA1 = 1 << 2,
+};
+
+// One <rom> from a DAT, as it's laid out in the index file
+struct DatRecord {
+    uint32_t crc32;
+    uint32_t flags; // DatRecordFlags
+    uint64_t size;
+    uint8_t md5[16];
+    uint8_t sha1[20];
+    uint32_t game; // Offsets into the index's string table
+    uint32_t rom;
+    uint32_t dat;
+};
+static_assert(sizeof(DatRecord) == 64, "The index file's layout depends on DatRecord's size");
+
+struct DatMatch {
+    const char* game;
+    const char* rom;
+    const char* dat;
+    bool bySha1; // False if the DAT only had a CRC-32 (and size) to go on
+};
+
+// Looks ROMs up in the Logiqx XML DATs (No-Intro, Redump, clrmamepro...) that the player has put in a directory.
+// Parsing the DATs is slow, so they're condensed into an index file the first time they're seen (or whenever they change),
+// and every later session just maps the index.
+// The index holds every <rom> sorted by CRC-32, a second ordering by SHA-1, and a table of the names they refer to,
+// so each lookup is a binary search.
+class DatIndex {
+public:
+    DatIndex() noexcept = default;
+    ~DatIndex() noexcept = default;
+    DatIndex(const DatIndex&) = delete;
+    DatIndex& operator=(const DatIndex&) = delete;
+    DatIndex(DatIndex&&) = delete;
+    DatIndex& operator=(DatIndex&&) = delete;
+
+    // Maps the index at indexPath, rebuilding it first if the DATs in datDirectory have changed since it was written.
+    // Returns false if there are no DATs or no usable index; lookups then never match.
+    bool Open(const char* datDirectory, const char* indexPath);
+    void Close() noexcept;
+
+    [[nodiscard]] bool IsOpen() const noexcept { return !_records.empty(); }
+    [[nodiscard]] bool WasRebuilt() const noexcept { return _rebuilt; }
+    [[nodiscard]] size_t GetDatCount() const noexcept { return _datCount; }
+    [[nodiscard]] size_t GetRecordCount() const noexcept { return _records.size(); }
+
+    // Returns false if no DAT has a ROM with these hashes.
+    // The strings in match point into the index and stay valid until it's closed or reopened.
+    [[nodiscard]] bool Find(const RomHashes& hashes, DatMatch& match) const noexcept;
+
+private:
+    RomFile _file {};
+    std::vector<uint8_t> _storage; // Holds the index if it was just built, or if it couldn't be mapped
+    nonstd::span<const DatRecord> _records {}; // Sorted by CRC-32, then size
+    nonstd::span<const uint32_t> _sha1Order {}; // Indexes of the records with SHA-1s, sorted by SHA-1
+    nonstd::span<const char> _strings {};
+    size_t _datCount = 0;
+    bool _rebuilt = false;
+
+    bool Load(nonstd::span<const uint8_t> index, uint64_t sourceStamp) noexcept;
+    [[nodiscard]] const char* GetString(uint32_t offset) const noexcept;
+};
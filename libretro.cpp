@@ -1,31 +1,43 @@
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <cstddef>
+#include <cstdio>
 #include <kiss_fft.h>
 #include <memory>
+#include <random>
+#include <string>
+#include <vector>
 
 #include <libretro.h>
 #include <pntr.h>
 #include <retro_assert.h>
-#include <audio/audio_mixer.h>
-#include <audio/conversion/float_to_s16.h>
+#include <retro_miscellaneous.h>
+#include <features/features_cpu.h>
+#include <file/file_path.h>
 #include <string/stdstring.h>
 
+#include "allocation_audit.hpp"
+#include "backdrop.hpp"
+#include "background.hpp"
 #include "blow.hpp"
 #include "cart.hpp"
 #include "constants.hpp"
+#include "damage.hpp"
+#include "dat_index.hpp"
+#include "mic_worker.hpp"
+#include "mixer.hpp"
+#include "options.hpp"
 #include "particles.hpp"
+#include "profiler.hpp"
+#include "rom_cache.hpp"
+#include "rom_hasher.hpp"
+#include "serialize.hpp"
+#include "sprites.hpp"
+#include "tiles.hpp"
+#include "worker_pool.hpp"
 
-#include "embedded/romcleaner_cart_png.h"
-#include "embedded/romcleaner_dust00_png.h"
-#include "embedded/romcleaner_dust01_png.h"
-#include "embedded/romcleaner_dust02_png.h"
-#include "embedded/romcleaner_dust03_png.h"
-#include "embedded/romcleaner_dust04_png.h"
-#include "embedded/romcleaner_dust05_png.h"
 #include "embedded/romcleaner_fanfare_wav.h"
-#include "embedded/romcleaner_sparkle00_png.h"
-#include "embedded/romcleaner_sparkle01_png.h"
-#include "embedded/romcleaner_sparkle02_png.h"
 
 using std::array;
 
@@ -40,6 +52,79 @@ namespace
     retro_log_printf_t _log = nullptr;
 }
 
+#define ROM_EXTENSIONS "sfc|smc|st|swc|bs|cgb|dmg|gb|gbc|sgb|a52|nes|3ds|3dsx|cart|rom|sms|bms|int|col|cv|md|mdx|smd|gen|gg|sg|gba|nds|lnx|lyx|pce|sgx|ws|wsc|vb|vboy|n64|z64|v64|vec"
+
+// "ROMCLEAN"; used for every session when the deterministic option is on
+constexpr uint64_t DETERMINISTIC_SEED = 0x524F4D434C45414Eull;
+
+// Each particle system draws from its own stream derived from the session's seed
+enum SeedStream : uint64_t {
+    SEED_STREAM_DUST,
+    SEED_STREAM_SPARKLES,
+};
+
+// "Auto" render threads never uses more than this; past it the tiles run out before the cores do
+constexpr unsigned MAX_AUTO_RENDER_THREADS = 8;
+
+// MD5, SHA-1 and reading each keep one thread busy, and CRC-32 is split across the rest;
+// past this many, CRC-32's pieces are so fast that hashing is bound by MD5 and SHA-1 anyway
+constexpr unsigned MAX_HASH_THREADS = 8;
+
+// Deterministic sessions count at least this much of the ROM as verified each step (about 60 MB/s)...
+constexpr uint64_t DETERMINISTIC_HASH_BUDGET = 1024 * 1024;
+// ...and more for big ROMs, so that no ROM takes longer than this many seconds to clear
+constexpr uint64_t DETERMINISTIC_HASH_SECONDS = 10;
+
+// DATs go in this subdirectory of the system directory, and the index built from them in this subdirectory of the save directory
+constexpr const char* CORE_DIRECTORY_NAME = "romcleaner";
+constexpr const char* DAT_INDEX_FILE_NAME = "dat_index.bin";
+constexpr const char* ROM_CACHE_FILE_NAME = "rom_cache.log";
+
+constexpr array<int16_t, MAX_SAMPLES_PER_FRAME * 2> SILENCE {};
+
+// Each frame reads at most this many frames' worth of microphone samples, which is enough to keep up at 15 FPS
+constexpr unsigned MAX_MIC_READS_PER_POLL = 4;
+
+// After a long stall (like a breakpoint or a paused frontend), skip ahead rather than simulating every missed step
+constexpr unsigned MAX_STEPS_PER_FRAME = 8;
+
+// Leftover time within this much of a whole step counts as one, so that 30 FPS always takes exactly two steps
+constexpr double TIME_STEP_TOLERANCE = 1e-9;
+
+#ifdef HAVE_PROFILER
+// One bar per phase, scaled so that a whole frame's budget spans PROFILER_OVERLAY_BUDGET_WIDTH pixels
+constexpr int PROFILER_OVERLAY_MARGIN = 4;
+constexpr int PROFILER_OVERLAY_BAR_HEIGHT = 6;
+constexpr int PROFILER_OVERLAY_BUDGET_WIDTH = 256;
+constexpr pntr_rectangle PROFILER_OVERLAY_BOUNDS {
+    0,
+    0,
+    PROFILER_OVERLAY_BUDGET_WIDTH * 2 + PROFILER_OVERLAY_MARGIN * 2,
+    (PROFILER_OVERLAY_BAR_HEIGHT + 2) * static_cast<int>(PROFILE_PHASE_COUNT) + PROFILER_OVERLAY_MARGIN * 2,
+};
+#endif
+
+struct RenderSize {
+    int width;
+    int height;
+    float scale; // Relative to SCREEN_WIDTH x SCREEN_HEIGHT
+};
+
+[[nodiscard]] constexpr RenderSize GetRenderSize(RenderResolution resolution) noexcept {
+    switch (resolution) {
+        case RenderResolution::Half:
+            return { SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 1.0f / 2 };
+        case RenderResolution::Third:
+            return { SCREEN_WIDTH / 3, SCREEN_HEIGHT / 3, 1.0f / 3 };
+        case RenderResolution::Fixed640x360:
+            // 640 / 1366 and 360 / 768 differ slightly; the smaller keeps everything on screen
+            return { 640, 360, std::min(640.0f / SCREEN_WIDTH, 360.0f / SCREEN_HEIGHT) };
+        case RenderResolution::Native:
+        default:
+            return { SCREEN_WIDTH, SCREEN_HEIGHT, 1.0f };
+    }
+}
+
 // Define game states
 enum class GameState {
     CART_ENTERING,  // Cart is animating into position
@@ -50,21 +135,9 @@ struct CoreState
 {
     CoreState() noexcept
     {
-        _framebuffer = pntr_new_image(SCREEN_WIDTH, SCREEN_HEIGHT);
-        retro_assert(_framebuffer != nullptr);
-
-        _gradientBg = pntr_new_image(SCREEN_WIDTH, SCREEN_HEIGHT);
-        pntr_draw_rectangle_gradient(_gradientBg, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, PNTR_BLUE, PNTR_BLUE, PNTR_SKYBLUE, PNTR_SKYBLUE);
+        retro_assert(!_fanfareSound.IsEmpty());
 
-        audio_mixer_init(SAMPLE_RATE);
-
-        _fanfareSound = audio_mixer_load_wav(
-            (void*)embedded_romcleaner_fanfare_wav,
-            sizeof(embedded_romcleaner_fanfare_wav),
-            "sinc",
-            RESAMPLER_QUALITY_DONTCARE
-        );
-        retro_assert(_fanfareSound != nullptr);
+        _renderPool = std::make_unique<WorkerPool>();
     }
 
     ~CoreState() noexcept
@@ -72,16 +145,9 @@ struct CoreState
         pntr_unload_image(_framebuffer);
         _framebuffer = nullptr;
 
-        pntr_unload_image(_gradientBg);
-        _gradientBg = nullptr;
-
-        audio_mixer_stop(_fanfareVoice);
-        _fanfareVoice = nullptr;
-
-        audio_mixer_destroy(_fanfareSound);
-        _fanfareSound = nullptr;
-
-        audio_mixer_done();
+#ifdef HAVE_THREADS
+        _micWorker.reset(); // Must stop reading the microphone before it's closed
+#endif
 
         if (_microphone) {
             _microphoneInterface.set_mic_state(_microphone, false);
@@ -95,22 +161,65 @@ struct CoreState
     CoreState& operator=(CoreState&&) = delete;
 
     bool LoadGame(const retro_game_info& game);
+    void UnloadGame();
+
+    // The size of the frames the core sends; only changes when content is loaded
+    [[nodiscard]] pntr_vector GetScreenSize() const noexcept { return { _screenWidth, _screenHeight }; }
+    [[nodiscard]] double GetFrameRate() const noexcept { return _options.frameRate; }
+
+    // How long it's been since the last frame, as reported by the frontend
+    void SetFrameTime(retro_usec_t usec) noexcept { _frameTime = usec; }
     void Run();
 
+    // Savestates have the same size for the whole session, so the frontend can preallocate them
+    [[nodiscard]] size_t GetStateSize() const noexcept;
+    bool Serialize(nonstd::span<uint8_t> data) const noexcept;
+    bool Unserialize(nonstd::span<const uint8_t> data) noexcept;
+
     const bool initialized = true;
 private:
-    audio_mixer_sound_t* _fanfareSound = nullptr;
-    audio_mixer_voice_t* _fanfareVoice = nullptr;
+    Sound _fanfareSound {embedded_romcleaner_fanfare_wav}; // Decoded and resampled once, up front
+    AudioMixer _mixer {};
+    AudioMixer::Voice _fanfareVoice = AudioMixer::NO_VOICE;
+    array<int16_t, MAX_SAMPLES_PER_FRAME * 2> _audioBuffer {};
+    size_t _samplesPerFrame = SAMPLES_PER_FRAME; // Per channel
     retro_microphone_interface _microphoneInterface {};
     retro_microphone* _microphone = nullptr;
     retro_microphone_params_t _actualMicParams {};
+    CoreOptions _options {};
+    uint64_t _seed = DETERMINISTIC_SEED;
+    std::unique_ptr<SpriteSet> _sprites; // Everything below borrows its images from here, so it must be declared first
     std::unique_ptr<ParticleSystem> _particles = nullptr;
     std::unique_ptr<ParticleSystem> _sparkles = nullptr;  // Sparkle effect particles
     std::unique_ptr<Cart> _cart;
     bool _micInitialized = false;
-    BlowDetector _blowDetector {};
+    RomHasher _romHasher {};
+    bool _hashInline = false; // Whether the ROM is hashed a block per step, because the hashing thread couldn't be started
+    uint64_t _hashBudget = 0; // In deterministic sessions, how much of the ROM counts as verified; saved in savestates, unlike the hasher
+    bool _romHashesReported = false;
+    RomCache _romCache {};
+    std::string _romPath; // Keys the ROM's hashes in the cache
+    FileStamp _romStamp {}; // What the ROM looked like when the session started
+    bool _romHashesCached = false; // Whether the hashes came from the cache instead of the ROM
+    DatIndex _datIndex {};
+    array<char, 256> _cleanMessage {}; // Shown once the dust is gone; says whether the ROM matched a DAT
+    BlowDetector _blowDetector {}; // Always saved in savestates, but idle while the background worker runs
+#ifdef HAVE_THREADS
+    std::unique_ptr<MicrophoneWorker> _micWorker;
+#endif
+    int _screenWidth = SCREEN_WIDTH;
+    int _screenHeight = SCREEN_HEIGHT;
+    float _scale = 1.0f; // Sprites, distances and speeds are all scaled by this, relative to the native resolution
     pntr_image* _framebuffer = nullptr;
-    pntr_image* _gradientBg = nullptr;
+    Background _background {};
+    Backdrop _backdrop {}; // The background with the settled cart already drawn on top
+    DamageTracker _damage {SCREEN_WIDTH, SCREEN_HEIGHT};
+    TileGrid _tiles {SCREEN_WIDTH, SCREEN_HEIGHT};
+    std::vector<pntr_rectangle> _tileTasks; // The damaged part of each tile, drawn independently of the others
+    std::unique_ptr<WorkerPool> _renderPool;
+    bool _backgroundDirty = true; // The whole framebuffer needs to be redrawn
+    std::vector<uint8_t> _stateBackup; // The state as it was before a load, so a load that fails can be undone
+    bool _canDupe = false; // Whether the frontend lets us skip sending unchanged frames
     float _dustLevel = 100.0f;  // Track dust level from 0-100
     float _blowStrength = 0.0f; // Track how strongly player is blowing
     
@@ -121,12 +230,34 @@ private:
     pntr_vector _cartTargetPosition {}; // Target position for cart (center of screen)
     pntr_vector _cartStartPosition {};  // Starting position for cart (above screen)
 
+    // The simulation advances in whole TIME_STEPs; this is the time that has passed but isn't yet a whole step
+    double _timeAccumulator = 0.0;
+    retro_usec_t _frameTime = 0; // 0 until the frontend reports a frame time, if it ever does
+
     bool InitMicrophone();
+    bool PollMicrophone() noexcept;
+    void Serialize(StateWriter& writer) const noexcept;
+    bool Unserialize(StateReader& reader) noexcept;
     void Update();
     void Render();
+    void DrawTile(pntr_rectangle clip) const noexcept;
+    void ApplyOptions(const CoreOptions& options);
+#ifdef HAVE_PROFILER
+    void DrawProfilerOverlay() noexcept;
+#endif
     void UpdateDustLevel(bool isBlowing);
+    [[nodiscard]] float GetUnverifiedDust() const noexcept;
+    bool GetCoreSaveDirectory(array<char, PATH_MAX_LENGTH>& directory) const;
+    void OpenRomCache();
+    void OpenDatIndex();
+    void ReportRomHashes() noexcept;
+    void CacheRomHashes(const RomHashes& hashes);
     void DisplayDustStatus();
     void UpdateCartAnimation();
+    [[nodiscard]] pntr_vector GetCartPositionAt(float time) const noexcept;
+    [[nodiscard]] double GetElapsedTime() const noexcept;
+    void SetRenderLead(float seconds) noexcept;
+    [[nodiscard]] pntr_rectangle GetDustSpawnArea() const noexcept;
 };
 
 namespace {
@@ -167,6 +298,7 @@ RETRO_API void retro_set_environment(retro_environment_t env)
     retro_pixel_format format = RETRO_PIXEL_FORMAT_XRGB8888;
     _environment(RETRO_ENVIRONMENT_GET_LOG_INTERFACE, &log);
     _environment(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &format);
+    RegisterCoreOptions(_environment);
 
     if (!_log && log.log)
     {
@@ -201,9 +333,17 @@ RETRO_API unsigned retro_api_version()
 RETRO_API void retro_get_system_info(retro_system_info *info)
 {
     info->library_name = "ROM Cleaner";
-    info->block_extract = false;
     info->library_version = "1.0.0";
-    info->valid_extensions = "sfc|smc|st|swc|bs|cgb|dmg|gb|gbc|sgb|a52|nes|3ds|3dsx|cart|rom|sms|bms|int|col|cv|md|mdx|smd|gen|gg|sg|gba|nds|lnx|lyx|pce|sgx|ws|wsc|vb|vboy|n64|z64|v64|vec";
+
+    // Zipped ROMs are read straight out of the archive, which saves the frontend extracting them to a temporary file.
+    // Stored entries can be read without zlib, but hardly any zips use them.
+#ifdef HAVE_ZLIB
+    info->block_extract = true;
+    info->valid_extensions = ROM_EXTENSIONS "|zip";
+#else
+    info->block_extract = false;
+    info->valid_extensions = ROM_EXTENSIONS;
+#endif
 
     // We don't actually use the ROM, so no need to load or patch anything
     info->need_fullpath = true;
@@ -212,11 +352,14 @@ RETRO_API void retro_get_system_info(retro_system_info *info)
 
 RETRO_API void retro_get_system_av_info(struct retro_system_av_info *info)
 {
-    info->geometry.base_width = SCREEN_WIDTH;
-    info->geometry.base_height = SCREEN_HEIGHT;
+    // Lower internal resolutions keep the native aspect ratio, so the frontend scales them up to fill the same space
+    pntr_vector size = Core.GetScreenSize();
+    info->geometry.base_width = size.x;
+    info->geometry.base_height = size.y;
     info->geometry.max_width = SCREEN_WIDTH;
     info->geometry.max_height = SCREEN_HEIGHT;
-    info->timing.fps = FPS;
+    info->geometry.aspect_ratio = static_cast<float>(SCREEN_WIDTH) / SCREEN_HEIGHT;
+    info->timing.fps = Core.GetFrameRate();
     info->timing.sample_rate = SAMPLE_RATE;
 }
 
@@ -238,13 +381,20 @@ RETRO_API void retro_reset(void)
 
 RETRO_API size_t retro_serialize_size(void)
 {
-    return 0;
+    return Core.GetStateSize();
 }
 
 /* Serializes internal state. If failed, or size is lower than
  * retro_serialize_size(), it should return false, true otherwise. */
-RETRO_API bool retro_serialize(void *data, size_t size) { return false; }
-RETRO_API bool retro_unserialize(const void *data, size_t size) { return false; }
+RETRO_API bool retro_serialize(void *data, size_t size)
+{
+    return Core.Serialize({ static_cast<uint8_t*>(data), size });
+}
+
+RETRO_API bool retro_unserialize(const void *data, size_t size)
+{
+    return Core.Unserialize({ static_cast<const uint8_t*>(data), size });
+}
 
 RETRO_API void retro_cheat_reset() {}
 RETRO_API void retro_cheat_set(unsigned, bool, const char *) {}
@@ -279,9 +429,19 @@ RETRO_API bool retro_load_game_special(unsigned, const retro_game_info *info, si
     return retro_load_game(info);
 }
 
+static void retro_frame_time(retro_usec_t usec)
+{
+    Core.SetFrameTime(usec);
+}
+
 /* Unloads the currently loaded game. Called before retro_deinit(void). */
-RETRO_API void retro_unload_game()
+RETRO_API void retro_unload_game() try
 {
+    PROFILE_REPORT();
+    Core.UnloadGame();
+}
+catch (const std::exception &e) {
+    _log(RETRO_LOG_ERROR, "Failed to unload the game: %s\n", e.what());
 }
 
 RETRO_API unsigned retro_get_region() { return RETRO_REGION_NTSC; }
@@ -299,7 +459,19 @@ RETRO_API size_t retro_get_memory_size(unsigned id)
 
 RETRO_API void retro_run()
 {
+#ifdef HAVE_ALLOCATION_AUDIT
+    // Everything a session needs is created by LoadGame; allocating mid-frame causes hitches on slow allocators
+    AllocationAuditBegin();
+    Core.Run();
+    size_t allocations = AllocationAuditEnd();
+    if (allocations > 0 && _log) {
+        _log(RETRO_LOG_ERROR, "retro_run made %zu allocation(s)\n", allocations);
+    }
+    retro_assert(allocations == 0);
+#else
     Core.Run();
+#endif
+    PROFILE_END_FRAME();
 }
 
 bool CoreState::LoadGame(const retro_game_info& game) {
@@ -312,14 +484,93 @@ bool CoreState::LoadGame(const retro_game_info& game) {
         throw std::runtime_error("Failed to get microphone interface");
     }
 
-    _cart = std::make_unique<Cart>(nonstd::span {embedded_romcleaner_cart_png, sizeof(embedded_romcleaner_cart_png)});
+    if (!_environment(RETRO_ENVIRONMENT_GET_CAN_DUPE, &_canDupe)) {
+        _canDupe = false;
+    }
+
+#ifdef HAVE_PROFILER
+    ProfilerInit(_environment, _log);
+#endif
+
+    ApplyOptions(ReadCoreOptions(_environment));
+    if (_options.deterministic) {
+        _seed = DETERMINISTIC_SEED;
+    } else {
+        std::random_device device;
+        _seed = (static_cast<uint64_t>(device()) << 32) | device();
+    }
+    _log(RETRO_LOG_DEBUG, "Session seed: %016llx\n", static_cast<unsigned long long>(_seed));
+
+    // Cleaning the cart is really verifying the ROM, so the dust can't come off any faster than the ROM is read.
+    // How fast that is varies from run to run, so deterministic sessions go by a fixed budget per step instead.
+    unsigned hashThreads = std::clamp(cpu_features_get_core_amount(), 1u, MAX_HASH_THREADS);
+    _hashInline = false;
+    _hashBudget = 0;
+    _romHashesReported = false;
+    _romHashesCached = false;
+    _romPath = game.path;
+    if (!GetRomStamp(game.path, _romStamp)) {
+        _romStamp = {};
+    }
+
+    // A ROM that's been verified before (and hasn't changed since) isn't read again.
+    // Deterministic sessions still clear at the budget's pace, since that only depends on the ROM's size.
+    OpenRomCache();
+    RomHashes cachedHashes {};
+    if (_romCache.Find(_romPath, _romStamp, cachedHashes)) {
+        _romHasher.Restore(cachedHashes);
+        _romHashesCached = true;
+        _log(RETRO_LOG_INFO, "%s hasn't changed since it was last verified\n", game.path);
+    } else if (_romHasher.Open(game.path, hashThreads)) {
+        if (!_romHasher.Start()) {
+            _log(RETRO_LOG_WARN, "Failed to start the hashing thread, hashing the ROM during each frame instead\n");
+            _hashInline = true;
+        }
+    } else {
+        _log(RETRO_LOG_WARN, "Failed to open %s, so it won't be verified\n", game.path);
+    }
+
+    _cleanMessage[0] = '\0';
+    OpenDatIndex();
+
+    // Without the frontend's frame times, every frame is assumed to take exactly as long as the frame rate says
+    _samplesPerFrame = static_cast<size_t>(SAMPLE_RATE / _options.frameRate);
+    _timeAccumulator = 0.0;
+    _frameTime = 0;
+    retro_frame_time_callback frameTime {
+        .callback = retro_frame_time,
+        .reference = static_cast<retro_usec_t>(1000000.0 / _options.frameRate),
+    };
+    if (!_environment(RETRO_ENVIRONMENT_SET_FRAME_TIME_CALLBACK, &frameTime)) {
+        _log(RETRO_LOG_WARN, "Frontend doesn't report frame times, assuming a steady %.0f FPS\n", _options.frameRate);
+    }
+
+    RenderSize renderSize = GetRenderSize(_options.resolution);
+    _screenWidth = renderSize.width;
+    _screenHeight = renderSize.height;
+    _scale = renderSize.scale;
+    _log(RETRO_LOG_INFO, "Rendering at %dx%d\n", _screenWidth, _screenHeight);
+
+    _framebuffer = pntr_new_image(_screenWidth, _screenHeight);
+    retro_assert(_framebuffer != nullptr);
+
+    _background = Background(_screenHeight, PNTR_BLUE, PNTR_SKYBLUE);
+
+    _damage = DamageTracker(_screenWidth, _screenHeight);
+    _tiles = TileGrid(_screenWidth, _screenHeight);
+
+    // Each tile can be split between every damage region at worst
+    _tileTasks.reserve(_tiles.GetTileCount() * DamageTracker::MAX_REGIONS);
+
+    _sprites = std::make_unique<SpriteSet>(_scale);
+    _cart = std::make_unique<Cart>(_sprites->Get(Sprite::Cart));
 
     // Calculate cart dimensions and positions
     pntr_vector cartSize = _cart->GetSize();
 
     _cartTargetPosition = {
-        SCREEN_WIDTH / 2 - cartSize.x / 2,
-        SCREEN_HEIGHT / 4 - cartSize.y / 4
+        _screenWidth / 2 - cartSize.x / 2,
+        _screenHeight / 4 - cartSize.y / 4
     };
     
     // Set start position (above screen)
@@ -336,33 +587,157 @@ bool CoreState::LoadGame(const retro_game_info& game) {
     _gameState = GameState::CART_ENTERING;
 
     // Initialize particles with multiple dust images
-    pntr_vector cartPos = _cart->GetPosition();
-    
-    std::array<nonstd::span<const uint8_t>, 6> dustImages = {
-        nonstd::span {embedded_romcleaner_dust00_png, sizeof(embedded_romcleaner_dust00_png)},
-        {embedded_romcleaner_dust01_png, sizeof(embedded_romcleaner_dust01_png)},
-        {embedded_romcleaner_dust02_png, sizeof(embedded_romcleaner_dust02_png)},
-        {embedded_romcleaner_dust03_png, sizeof(embedded_romcleaner_dust03_png)},
-        {embedded_romcleaner_dust04_png, sizeof(embedded_romcleaner_dust04_png)},
-        {embedded_romcleaner_dust05_png, sizeof(embedded_romcleaner_dust05_png)},
-    };
-    
     _particles = std::make_unique<ParticleSystem>(
-        dustImages,
+        _sprites->GetDust(),
         ParticleSystemArgs {
             .maxParticles = 400,
             .spawnRate = 300,
             .baseTimeToLive = .75,
-            .baseVelocity = { 0, 300 },
-            .spawnArea = { cartPos.x, cartPos.y + cartSize.y, _cart->GetSize().x, 4 },
-            .deceleration = 300.0,  // Strong deceleration for dust (px/s²)
-            .edgeAngleOffset = 30
+            .baseVelocity = { 0, static_cast<int>(std::lround(300 * _scale)) },
+            .spawnArea = GetDustSpawnArea(),
+            .deceleration = 300.0 * _scale,  // Strong deceleration for dust (px/s²)
+            .edgeAngleOffset = 30,
+            .seed = DeriveSeed(_seed, SEED_STREAM_DUST),
+        }
+    );
+
+    // Created up front so that savestates are the same size before and after the ROM is clean;
+    // it doesn't spawn anything until then
+    _sparkles = std::make_unique<ParticleSystem>(
+        _sprites->GetSparkles(),
+        ParticleSystemArgs {
+            .maxParticles = 40,
+            .spawnRate = 5,           // Spawn 5 sparkles per second
+            .baseTimeToLive = 0.5f,   // Short-lived sparkles
+            .baseVelocity = { 0, 0 }, // Sparkles don't move
+            .spawnArea = _cart->GetBounds(),
+            .seed = DeriveSeed(_seed, SEED_STREAM_SPARKLES),
         }
     );
 
+    // Nothing that runs every frame should have to allocate
+    _particles->ReserveBins(_tiles);
+    _sparkles->ReserveBins(_tiles);
+    _backdrop.Reserve(cartSize.x, cartSize.y);
+    _stateBackup.resize(GetStateSize());
+
+    return true;
+}
+
+// The ROM's hashes are only written to the cache here, so that retro_run never waits on the disk
+void CoreState::UnloadGame() {
+    if (!_romHashesCached && _romHasher.GetStatus() == RomHasher::Status::Done) {
+        CacheRomHashes(_romHasher.GetHashes());
+    }
+    _romCache.Close();
+}
+
+size_t CoreState::GetStateSize() const noexcept {
+    if (!_cart)
+        return 0; // Nothing to save until a game is loaded
+
+    StateWriter counter;
+    Serialize(counter);
+    return counter.GetSize();
+}
+
+bool CoreState::Serialize(nonstd::span<uint8_t> data) const noexcept {
+    if (!_cart)
+        return false;
+
+    StateWriter writer(data);
+    Serialize(writer);
+    return writer.IsOk();
+}
+
+void CoreState::Serialize(StateWriter& writer) const noexcept {
+    writer.Write(STATE_MAGIC);
+    writer.Write(STATE_VERSION);
+    writer.Write(static_cast<int32_t>(_screenWidth));
+    writer.Write(static_cast<int32_t>(_screenHeight));
+    writer.Write(static_cast<uint32_t>(_gameState));
+    writer.Write(_cartAnimationTime);
+    writer.Write(_dustLevel);
+    writer.Write(_blowStrength);
+    writer.Write(_hashBudget);
+    _cart->Serialize(writer);
+    _particles->Serialize(writer);
+    _sparkles->Serialize(writer);
+    _blowDetector.Serialize(writer);
+}
+
+bool CoreState::Unserialize(nonstd::span<const uint8_t> data) noexcept {
+    if (!_cart || data.size() < GetStateSize())
+        return false;
+
+    // A state can turn out to be bad after some of it was already loaded,
+    // so the current state is kept aside and put back if that happens
+    StateWriter backup(_stateBackup);
+    Serialize(backup);
+    retro_assert(backup.IsOk());
+
+    StateReader reader(data);
+    if (!Unserialize(reader)) {
+        StateReader undo(_stateBackup);
+        [[maybe_unused]] bool undone = Unserialize(undo);
+        retro_assert(undone);
+        return false;
+    }
+
+    // Whatever's in the framebuffer belongs to the state we just left
+    _backgroundDirty = true;
+    _backdrop.Invalidate();
+
+    // Rewinding to before the ROM was clean shouldn't leave the fanfare playing
+    if (!_sparkles->IsSpawning()) {
+        _mixer.Stop(_fanfareVoice);
+        _fanfareVoice = AudioMixer::NO_VOICE;
+    }
+
     return true;
 }
 
+bool CoreState::Unserialize(StateReader& reader) noexcept {
+    uint32_t magic = 0, version = 0, gameState = 0;
+    int32_t width = 0, height = 0;
+    reader.Read(magic);
+    reader.Read(version);
+    if (!reader.IsOk() || magic != STATE_MAGIC || version != STATE_VERSION) {
+        _log(RETRO_LOG_ERROR, "Savestate is not compatible with this version of the core\n");
+        return false;
+    }
+
+    // Positions and speeds are in pixels, so they only make sense at the resolution they were saved at
+    reader.Read(width);
+    reader.Read(height);
+    if (!reader.IsOk() || width != _screenWidth || height != _screenHeight) {
+        _log(RETRO_LOG_ERROR, "Savestate was made at %dx%d, but the core is rendering at %dx%d\n", width, height, _screenWidth, _screenHeight);
+        return false;
+    }
+
+    reader.Read(gameState);
+    if (!reader.IsOk() || gameState > static_cast<uint32_t>(GameState::CART_READY)) {
+        _log(RETRO_LOG_ERROR, "Savestate is corrupt\n");
+        return false;
+    }
+
+    _gameState = static_cast<GameState>(gameState);
+    reader.Read(_cartAnimationTime);
+    reader.Read(_dustLevel);
+    reader.Read(_blowStrength);
+    reader.Read(_hashBudget);
+
+    bool ok = _cart->Unserialize(reader)
+        && _particles->Unserialize(reader)
+        && _sparkles->Unserialize(reader)
+        && _blowDetector.Unserialize(reader);
+
+    if (!ok) {
+        _log(RETRO_LOG_ERROR, "Failed to load savestate\n");
+    }
+
+    return ok;
+}
 
 bool CoreState::InitMicrophone() {
     retro_microphone_params_t params { 44100 };
@@ -385,50 +760,175 @@ bool CoreState::InitMicrophone() {
     }
     _log(RETRO_LOG_INFO, "Microphone parameters: rate = %u\n", _actualMicParams.rate);
 
+#ifdef HAVE_THREADS
+    // Background decisions depend on thread timing, so deterministic sessions always analyze inline
+    if (_options.micThread && !_options.deterministic) {
+        _micWorker = std::make_unique<MicrophoneWorker>(_microphoneInterface, _microphone);
+        if (_micWorker->IsRunning()) {
+            _log(RETRO_LOG_INFO, "Analyzing the microphone in the background\n");
+        } else {
+            _log(RETRO_LOG_WARN, "Failed to start the microphone threads, analyzing it inline instead\n");
+            _micWorker.reset();
+        }
+    }
+#endif
+
     return true;
 }
 
+// Returns whether the player is blowing into the microphone
+bool CoreState::PollMicrophone() noexcept {
+#ifdef HAVE_THREADS
+    if (_micWorker)
+        return _micWorker->IsBlowing();
+#endif
+
+    // Drain what the microphone has, up to a few frames' worth; the detector makes its decisions on its own schedule,
+    // so it doesn't matter how the frontend splits up the samples.
+    // Some frontends always fill the buffer (with silence, if the mic is inactive), so draining until a short read could never end.
+    std::array<int16_t, SAMPLES_PER_FRAME> samples {};
+    for (unsigned reads = 0; reads < MAX_MIC_READS_PER_POLL; ++reads) {
+        int samplesRead = _microphoneInterface.read_mic(_microphone, samples.data(), samples.size());
+        if (samplesRead > 0) {
+            _blowDetector.Push(nonstd::span<const int16_t>(samples.data(), samplesRead));
+        }
+
+        if (samplesRead < static_cast<int>(samples.size()))
+            break;
+    }
+
+    return _blowDetector.IsBlowing();
+}
+
+// Only options that can change mid-session take effect here; the rest are read once, by LoadGame
+void CoreState::ApplyOptions(const CoreOptions& options) {
+    if (!_cart) {
+        _options.deterministic = options.deterministic;
+        _options.resolution = options.resolution;
+        _options.frameRate = options.frameRate;
+    }
+    _options.renderThreads = options.renderThreads;
+    _options.micThread = options.micThread;
+
+    // Turning the overlay off leaves it in the framebuffer until the background is restored
+    if (options.profilerOverlay != _options.profilerOverlay) {
+        _options.profilerOverlay = options.profilerOverlay;
+        _backgroundDirty = true;
+    }
+
+    unsigned threads = options.renderThreads;
+    if (threads == 0) {
+        threads = std::clamp(cpu_features_get_core_amount(), 1u, MAX_AUTO_RENDER_THREADS);
+    }
+
+    if (threads != _renderPool->GetThreadCount()) {
+        _renderPool.reset(); // Join the old threads before starting new ones
+        _renderPool = std::make_unique<WorkerPool>(threads);
+        _log(RETRO_LOG_INFO, "Rendering with %u thread(s)\n", static_cast<unsigned>(_renderPool->GetThreadCount()));
+    }
+}
+
 void CoreState::Run()
 {
+    PROFILE_SCOPE(Run);
+
+    bool optionsChanged = false;
+    if (_environment(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &optionsChanged) && optionsChanged) {
+        ALLOCATION_AUDIT_EXEMPT();
+        ApplyOptions(ReadCoreOptions(_environment));
+    }
+
     if (!_micInitialized && _gameState == GameState::CART_READY) {
+        // Only happens once, and the frontend may need to ask the player for permission first
+        ALLOCATION_AUDIT_EXEMPT();
         _micInitialized = InitMicrophone();
     }
 
     _input_poll();
 
-    Update();
+    // Take as many whole steps as fit in the time that has passed, and carry the rest over to the next frame
+    _timeAccumulator += GetElapsedTime();
+    unsigned steps = 0;
+    while (_timeAccumulator + TIME_STEP_TOLERANCE >= TIME_STEP) {
+        if (steps == MAX_STEPS_PER_FRAME) {
+            _timeAccumulator = 0.0;
+            break;
+        }
+
+        Update();
+        _timeAccumulator = std::max(_timeAccumulator - TIME_STEP, 0.0);
+        ++steps;
+    }
+
+    // The simulation is behind real time by whatever's left over, so draw things that much further along
+    SetRenderLead(static_cast<float>(_timeAccumulator));
     Render();
 }
 
+// The time to simulate this frame, in seconds
+double CoreState::GetElapsedTime() const noexcept {
+    // Deterministic sessions have to take the same steps every run, however long the frames really took
+    if (_options.deterministic || _frameTime == 0)
+        return 1.0 / _options.frameRate;
+
+    return static_cast<double>(_frameTime) / 1000000.0;
+}
+
+void CoreState::SetRenderLead(float seconds) noexcept {
+    if (_cart && _gameState == GameState::CART_ENTERING) {
+        _cart->SetPosition(GetCartPositionAt(_cartAnimationTime + seconds));
+    }
+
+    if (_particles) {
+        _particles->SetRenderLead(seconds);
+    }
+
+    if (_sparkles) {
+        _sparkles->SetRenderLead(seconds);
+    }
+}
+
 void CoreState::Update() {
+    PROFILE_SCOPE(Update);
+
     // Handle cart entry animation
     if (_gameState == GameState::CART_ENTERING) {
         UpdateCartAnimation();
     }
 
+    if (_hashInline) {
+        _romHasher.Step();
+    }
+
+    // The hasher isn't rewound along with savestates, so deterministic sessions go by a budget that is
+    uint64_t romSize = _romHasher.GetSize();
+    if (_options.deterministic) {
+        uint64_t budget = std::max(DETERMINISTIC_HASH_BUDGET, romSize / static_cast<uint64_t>(DETERMINISTIC_HASH_SECONDS * SIMULATION_RATE) + 1);
+        _hashBudget = std::min(_hashBudget + budget, romSize);
+    }
+
+    // Deterministic sessions report once the budget's used up, if the hashes are ready by then; the report only goes to the log and OSD
+    bool reportDue = !_options.deterministic || _hashBudget >= romSize;
+    if (!_romHashesReported && reportDue && _romHasher.GetStatus() != RomHasher::Status::Hashing) {
+        ReportRomHashes();
+        _romHashesReported = true;
+    }
+
     // Only process microphone input when cart is in position
     if (_gameState == GameState::CART_READY) {
-        std::array<int16_t, SAMPLES_PER_FRAME> samples {};
-        int samplesRead = _microphoneInterface.read_mic(_microphone, samples.data(), samples.size());
-
-        bool isBlowing = false;
-        if (samplesRead > 0) {
-            isBlowing = _blowDetector.IsBlowing(nonstd::span(samples.data(), samplesRead));
-            
-            // Instead of showing debug message, update dust level based on blowing
-            if (isBlowing) {
-                // Optionally, get blow intensity from detector if implemented
-                _blowStrength = 1.0f; // Default value if intensity not available
-            } else {
-                _blowStrength = 0.0f;
-            }
-            
-            // Update dust level based on blowing
-            UpdateDustLevel(isBlowing);
-            
-            // Display current dust status to player
+        bool isBlowing = PollMicrophone();
+
+        // Instead of showing debug message, update dust level based on blowing
+        if (isBlowing) {
+            // Optionally, get blow intensity from detector if implemented
+            _blowStrength = 1.0f; // Default value if intensity not available
+        } else {
+            _blowStrength = 0.0f;
         }
 
+        // Update dust level based on blowing
+        UpdateDustLevel(isBlowing);
+
         DisplayDustStatus();
 
         if (_particles) {
@@ -443,33 +943,13 @@ void CoreState::Update() {
             }
         }
 
-        // If dust level reaches zero and we haven't created sparkles yet, create them
-        if (_dustLevel <= 0 && !_sparkles) {
-            // Create sparkle particle system
-            std::array<nonstd::span<const uint8_t>, 3> sparkleImages = {
-                nonstd::span { embedded_romcleaner_sparkle00_png, sizeof(embedded_romcleaner_sparkle00_png) },
-                { embedded_romcleaner_sparkle01_png, sizeof(embedded_romcleaner_sparkle01_png) },
-                { embedded_romcleaner_sparkle02_png, sizeof(embedded_romcleaner_sparkle02_png) },
-            };
-
-            pntr_vector cartPos = _cart->GetPosition();
-            pntr_vector cartSize = _cart->GetSize();
-
-            _sparkles = std::make_unique<ParticleSystem>(
-                sparkleImages,
-                ParticleSystemArgs {
-                    .maxParticles = 40,
-                    .spawnRate = 5,           // Spawn 5 sparkles per second
-                    .baseTimeToLive = 0.5f,   // Short-lived sparkles
-                    .baseVelocity = { 0, 0 }, // Sparkles don't move
-                    .spawnArea = { cartPos.x, cartPos.y, cartSize.x, cartSize.y },
-                }
-            );
-
+        // If dust level reaches zero and we haven't started sparkling yet, start now
+        if (_dustLevel <= 0 && !_sparkles->IsSpawning()) {
+            _sparkles->SetSpawnArea(_cart->GetBounds());
             _sparkles->SetSpawning(true);
 
-            _fanfareVoice = audio_mixer_play(_fanfareSound, false, 1.0f, "sinc", RESAMPLER_QUALITY_DONTCARE, nullptr);
-            retro_assert(_fanfareVoice != nullptr);
+            _fanfareVoice = _mixer.Play(_fanfareSound);
+            retro_assert(_fanfareVoice != AudioMixer::NO_VOICE);
         }
     }
 
@@ -497,36 +977,49 @@ void CoreState::UpdateCartAnimation() {
         _cart->SetPosition(_cartTargetPosition);
         _gameState = GameState::CART_READY;
     } else {
-        // Calculate eased position
-        float progress = _cartAnimationTime / _cartAnimationDuration;
-        
-        // Apply easing function (ease-out cubic)
-        float easedProgress = 1.0f - (1.0f - progress) * (1.0f - progress) * (1.0f - progress);
-        
-        // Interpolate position
-        int x = _cartStartPosition.x + (int)(easedProgress * (_cartTargetPosition.x - _cartStartPosition.x));
-        int y = _cartStartPosition.y + (int)(easedProgress * (_cartTargetPosition.y - _cartStartPosition.y));
-        
-        _cart->SetPosition(x, y);
+        _cart->SetPosition(GetCartPositionAt(_cartAnimationTime));
         
         // Update particle spawn area to follow cart
         if (_particles) {
-            pntr_vector cartPos = _cart->GetPosition();
-            pntr_vector cartSize = _cart->GetSize();
-            _particles->SetSpawnArea({
-                cartPos.x, cartPos.y + cartSize.y, 
-                cartSize.x, 4
-            });
+            _particles->SetSpawnArea(GetDustSpawnArea());
         }
     }
 }
 
+// Where the cart is, this many seconds into its entrance animation
+pntr_vector CoreState::GetCartPositionAt(float time) const noexcept {
+    if (time >= _cartAnimationDuration)
+        return _cartTargetPosition;
+
+    // Calculate eased position
+    float progress = time / _cartAnimationDuration;
+
+    // Apply easing function (ease-out cubic)
+    float easedProgress = 1.0f - (1.0f - progress) * (1.0f - progress) * (1.0f - progress);
+
+    // Interpolate position
+    int x = _cartStartPosition.x + (int)(easedProgress * (_cartTargetPosition.x - _cartStartPosition.x));
+    int y = _cartStartPosition.y + (int)(easedProgress * (_cartTargetPosition.y - _cartStartPosition.y));
+
+    return { x, y };
+}
+
+// A thin strip along the bottom of the cart
+pntr_rectangle CoreState::GetDustSpawnArea() const noexcept {
+    pntr_vector cartPos = _cart->GetPosition();
+    pntr_vector cartSize = _cart->GetSize();
+    int height = std::max(1, static_cast<int>(std::lround(4 * _scale)));
+
+    return { cartPos.x, cartPos.y + cartSize.y, cartSize.x, height };
+}
+
 // New method to update dust level
 void CoreState::UpdateDustLevel(bool isBlowing) {
     if (isBlowing && _dustLevel > 0) {
-        // Decrease dust level when blowing, with a minimum of 0
+        // Decrease dust level when blowing, but no further than the ROM has been verified
         constexpr float decreaseRate = 85.0f; // Dust decrease per second when blowing
-        _dustLevel -= decreaseRate * TIME_STEP;
+        float floor = std::min(_dustLevel, GetUnverifiedDust());
+        _dustLevel = std::max(static_cast<float>(_dustLevel - decreaseRate * TIME_STEP), floor);
 
         // TODO: Increase particle emission when dust is higher
         if (_particles) {
@@ -535,6 +1028,133 @@ void CoreState::UpdateDustLevel(bool isBlowing) {
     }
 }
 
+// How much dust covers the part of the ROM that hasn't been verified yet, from 0-100
+float CoreState::GetUnverifiedDust() const noexcept {
+    uint64_t size = _romHasher.GetSize();
+    if (size == 0)
+        return 0.0f;
+
+    // Deterministic sessions go by the budget alone; when (or whether) the hasher finishes depends on the disk and the thread
+    if (_options.deterministic)
+        return static_cast<float>(100.0 * (1.0 - static_cast<double>(std::min(_hashBudget, size)) / static_cast<double>(size)));
+
+    // A ROM that can't be read doesn't hold the player up
+    if (_romHasher.GetStatus() != RomHasher::Status::Hashing)
+        return 0.0f;
+
+    double verified = static_cast<double>(_romHasher.GetBytesHashed()) / static_cast<double>(size);
+    return static_cast<float>(100.0 * (1.0 - verified));
+}
+
+// Everything the core writes for itself goes in a subdirectory of the save directory, created if need be
+bool CoreState::GetCoreSaveDirectory(array<char, PATH_MAX_LENGTH>& directory) const {
+    const char* saveDirectory = nullptr;
+    if (!_environment(RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY, &saveDirectory) || string_is_empty(saveDirectory))
+        return false;
+
+    fill_pathname_join(directory.data(), saveDirectory, CORE_DIRECTORY_NAME, directory.size());
+    return path_mkdir(directory.data());
+}
+
+void CoreState::OpenRomCache() {
+    array<char, PATH_MAX_LENGTH> directory {};
+    array<char, PATH_MAX_LENGTH> cachePath {};
+    if (!GetCoreSaveDirectory(directory)) {
+        _log(RETRO_LOG_INFO, "No save directory, so verified ROMs won't be remembered\n");
+        return;
+    }
+
+    fill_pathname_join(cachePath.data(), directory.data(), ROM_CACHE_FILE_NAME, cachePath.size());
+    if (_romCache.Open(cachePath.data())) {
+        _log(RETRO_LOG_DEBUG, "Loaded %zu ROMs' hashes from %s\n", _romCache.GetEntryCount(), cachePath.data());
+    } else {
+        _log(RETRO_LOG_WARN, "Failed to open %s, so verified ROMs won't be remembered\n", cachePath.data());
+    }
+}
+
+// Maps the index of the player's DATs (building it first if they've changed), so the ROM's hashes can be looked up
+void CoreState::OpenDatIndex() {
+    const char* systemDirectory = nullptr;
+    if (!_environment(RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY, &systemDirectory) || string_is_empty(systemDirectory)) {
+        _log(RETRO_LOG_INFO, "No system directory, so the ROM won't be checked against any DATs\n");
+        return;
+    }
+
+    array<char, PATH_MAX_LENGTH> datDirectory {};
+    fill_pathname_join(datDirectory.data(), systemDirectory, CORE_DIRECTORY_NAME, datDirectory.size());
+
+    // The system directory may be read-only, and the index is ours rather than the player's anyway
+    array<char, PATH_MAX_LENGTH> coreSaveDirectory {};
+    array<char, PATH_MAX_LENGTH> indexPath {};
+    if (GetCoreSaveDirectory(coreSaveDirectory)) {
+        fill_pathname_join(indexPath.data(), coreSaveDirectory.data(), DAT_INDEX_FILE_NAME, indexPath.size());
+    }
+
+    if (!_datIndex.Open(datDirectory.data(), string_is_empty(indexPath.data()) ? nullptr : indexPath.data())) {
+        _log(RETRO_LOG_INFO, "No DATs in %s, so the ROM won't be checked against any\n", datDirectory.data());
+        return;
+    }
+
+    _log(
+        RETRO_LOG_INFO,
+        "%s %zu ROMs from %zu DATs\n",
+        _datIndex.WasRebuilt() ? "Indexed" : "Loaded the index of",
+        _datIndex.GetRecordCount(),
+        _datIndex.GetDatCount()
+    );
+}
+
+void CoreState::ReportRomHashes() noexcept {
+    switch (_romHasher.GetStatus()) {
+        case RomHasher::Status::Done: {
+            const RomHashes& hashes = _romHasher.GetHashes();
+            _log(
+                RETRO_LOG_INFO,
+                "%s %llu bytes of %s ROM: CRC32 %08x, MD5 %s, SHA-1 %s\n",
+                _romHashesCached ? "Previously verified" : "Verified",
+                static_cast<unsigned long long>(hashes.size),
+                GetRomFormatName(hashes.format),
+                static_cast<unsigned>(hashes.crc32),
+                ToHex(hashes.md5).data(),
+                ToHex(hashes.sha1).data()
+            );
+
+            DatMatch match {};
+            if (_datIndex.Find(hashes, match)) {
+                _log(
+                    RETRO_LOG_INFO,
+                    "Matches %s (%s) in %s%s\n",
+                    match.game,
+                    match.rom,
+                    match.dat,
+                    match.bySha1 ? "" : ", by CRC-32 and size"
+                );
+                snprintf(_cleanMessage.data(), _cleanMessage.size(), "Your ROM is clean! It's a good dump of %s.", match.game);
+            } else if (_datIndex.IsOpen()) {
+                _log(RETRO_LOG_WARN, "Doesn't match any ROM in the %zu DATs\n", _datIndex.GetDatCount());
+                snprintf(_cleanMessage.data(), _cleanMessage.size(), "Your ROM is clean, but it doesn't match any known dump.");
+            }
+            break;
+        }
+        case RomHasher::Status::Failed:
+            _log(RETRO_LOG_WARN, "Failed to read the whole ROM, so it couldn't be verified\n");
+            break;
+        default:
+            break;
+    }
+}
+
+// Remembers the hashes for next session, unless the ROM changed while it was being read
+void CoreState::CacheRomHashes(const RomHashes& hashes) {
+    FileStamp stamp {};
+    if (!_romCache.IsOpen() || !GetRomStamp(_romPath.c_str(), stamp) || stamp != _romStamp)
+        return;
+
+    if (!_romCache.Store(_romPath, stamp, hashes)) {
+        _log(RETRO_LOG_WARN, "Failed to remember the ROM's hashes for next time\n");
+    }
+}
+
 // New method to display dust status
 void CoreState::DisplayDustStatus() {
     retro_message_ext message = {};
@@ -550,36 +1170,140 @@ void CoreState::DisplayDustStatus() {
     }
     else {
         // Show special message when cartridge is clean
-        message.msg = "Your ROM is clean!";
+        message.msg = string_is_empty(_cleanMessage.data()) ? "Your ROM is clean!" : _cleanMessage.data();
     }
 
     _environment(RETRO_ENVIRONMENT_SET_MESSAGE_EXT, &message);
 }
 
 void CoreState::Render() {
-    pntr_draw_image(_framebuffer, _gradientBg, 0, 0);
+    PROFILE_SCOPE(Render);
+
+    _damage.Clear();
+
+    if (_backgroundDirty) {
+        _damage.AddAll();
+        _backgroundDirty = false;
+    }
 
     if (_cart) {
-        _cart->Draw(*_framebuffer);
+        _cart->ReportDamage(_damage);
+    }
+
+    if (_particles) {
+        _particles->ReportDamage(_damage);
+    }
+
+    if (_sparkles) {
+        _sparkles->ReportDamage(_damage);
+    }
+
+#ifdef HAVE_PROFILER
+    if (_options.profilerOverlay) {
+        _damage.Add(PROFILER_OVERLAY_BOUNDS);
+    }
+#endif
+
+    // Only restore and redraw what changed; everything else is still in the framebuffer from last frame.
+    // The damage regions don't overlap, so neither do their pieces of each tile,
+    // and every piece can be drawn on its own thread.
+    _tileTasks.clear();
+    for (pntr_rectangle region : _damage.GetRegions()) {
+        TileSpan span = _tiles.GetSpan(region);
+        for (int row = span.firstRow; row < span.endRow; ++row) {
+            for (int column = span.firstColumn; column < span.endColumn; ++column) {
+                _tileTasks.push_back(RectIntersection(region, _tiles.GetTileRect(column, row)));
+            }
+        }
+    }
+
+    if (!_tileTasks.empty()) {
+        // Once the cart stops moving it only has to be blended once, not every time dust passes over it
+        const Cart* staticCart = _gameState == GameState::CART_READY ? _cart.get() : nullptr;
+        _backdrop.Update(_background, staticCart);
+
+        if (_particles) {
+            _particles->Bin(_tiles);
+        }
+
+        if (_sparkles) {
+            _sparkles->Bin(_tiles);
+        }
+
+        auto drawTile = [this](size_t i) noexcept { DrawTile(_tileTasks[i]); };
+        _renderPool->Run(_tileTasks.size(), drawTile);
+    }
+
+#ifdef HAVE_PROFILER
+    if (_options.profilerOverlay) {
+        DrawProfilerOverlay();
+    }
+#endif
+
+    // Most of the session is silent, and silent frames don't need any mixing
+    const int16_t* audio = SILENCE.data();
+    {
+        PROFILE_SCOPE(AudioMix);
+        if (_mixer.Mix({ _audioBuffer.data(), _samplesPerFrame * 2 })) {
+            audio = _audioBuffer.data();
+        }
+    }
+
+    // A null frame tells the frontend to show the previous one again
+    const void* frame = (_damage.IsEmpty() && _canDupe) ? nullptr : _framebuffer->data;
+    {
+        PROFILE_SCOPE(VideoRefresh);
+        _video_refresh(frame, _screenWidth, _screenHeight, _screenWidth * sizeof(pntr_color));
+    }
+    _audio_sample_batch(audio, _samplesPerFrame);
+}
+
+// Runs on any of the render threads, so it must only read shared state
+void CoreState::DrawTile(pntr_rectangle clip) const noexcept {
+    _backdrop.Draw(*_framebuffer, clip);
+
+    if (_cart && !_backdrop.HasCart()) {
+        _cart->Draw(*_framebuffer, clip);
         // TODO: Shake the cart as the player blows into it
     }
 
     if (_particles) {
-        _particles->Draw(*_framebuffer);
+        _particles->Draw(*_framebuffer, clip);
     }
-    
+
     // Draw sparkles on top of everything if they exist
     if (_sparkles) {
-        _sparkles->Draw(*_framebuffer);
+        _sparkles->Draw(*_framebuffer, clip);
     }
+}
 
-    array<float, SAMPLE_RATE * 2 / 60> buffer {};
-    array<int16_t, SAMPLE_RATE * 2 / 60> outbuffer {};
+#ifdef HAVE_PROFILER
+// Charts how long each phase took last frame; the overlay's bounds are redrawn every frame while it's on
+void CoreState::DrawProfilerOverlay() noexcept {
+    const std::array<pntr_color, PROFILE_PHASE_COUNT> colors {
+        PNTR_WHITE,   // Run
+        PNTR_GREEN,   // Update
+        PNTR_YELLOW,  // Render
+        PNTR_SKYBLUE, // ParticlesUpdate
+        PNTR_BLUE,    // ParticlesDraw
+        PNTR_ORANGE,  // BlowDetect
+        PNTR_PURPLE,  // AudioMix
+        PNTR_RED,     // VideoRefresh
+    };
 
-    audio_mixer_mix(buffer.data(), buffer.size() / 2, 1.0f, false);
-    convert_float_to_s16(outbuffer.data(), buffer.data(), buffer.size());
+    const pntr_rectangle& bounds = PROFILER_OVERLAY_BOUNDS;
+    double budget = 1000000.0 / _options.frameRate;
+    int maxWidth = bounds.width - PROFILER_OVERLAY_MARGIN * 2;
 
-    _video_refresh(_framebuffer->data, SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_WIDTH * sizeof(pntr_color));
-    _audio_sample_batch(outbuffer.data(), outbuffer.size() / 2);
-}
+    pntr_draw_rectangle_fill(_framebuffer, bounds.x, bounds.y, bounds.width, bounds.height, PNTR_BLACK);
+    for (size_t i = 0; i < PROFILE_PHASE_COUNT; ++i) {
+        double time = ProfilerGetLastFrameMicroseconds(static_cast<ProfilePhase>(i));
+        double width = std::clamp(time / budget * PROFILER_OVERLAY_BUDGET_WIDTH, 1.0, static_cast<double>(maxWidth));
+        int y = bounds.y + PROFILER_OVERLAY_MARGIN + static_cast<int>(i) * (PROFILER_OVERLAY_BAR_HEIGHT + 2);
+        pntr_draw_rectangle_fill(_framebuffer, bounds.x + PROFILER_OVERLAY_MARGIN, y, static_cast<int>(width), PROFILER_OVERLAY_BAR_HEIGHT, colors[i]);
+    }
 
+    // Any bar that crosses this line blew the frame's budget on its own
+    pntr_draw_rectangle_fill(_framebuffer, bounds.x + PROFILER_OVERLAY_MARGIN + PROFILER_OVERLAY_BUDGET_WIDTH, bounds.y, 1, bounds.height, PNTR_WHITE);
+}
+#endif
@@ -0,0 +1,99 @@
+#include "mic_worker.hpp"
+
+#ifdef HAVE_THREADS
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+#include <retro_timers.h>
+
+#include "constants.hpp"
+
+// How long each thread naps when it runs out of work.
+// Well under the detector's hop (about 8ms by default), so decisions are never late by more than a frame.
+static constexpr unsigned CAPTURE_INTERVAL_MS = 2;
+static constexpr unsigned ANALYSIS_INTERVAL_MS = 2;
+
+MicrophoneWorker::MicrophoneWorker(const retro_microphone_interface& interface, retro_microphone_t* microphone, const BlowDetectorArgs& args) :
+    _interface(interface),
+    _microphone(microphone),
+    _detector(args)
+{
+    retro_microphone_params_t params {};
+    if (_interface.get_params && _interface.get_params(_microphone, &params) && params.rate > 0) {
+        _rate = params.rate;
+    }
+
+    _captureThread = sthread_create(CaptureMain, this);
+    _analysisThread = sthread_create(AnalysisMain, this);
+    if (!IsRunning()) {
+        Stop();
+    }
+}
+
+MicrophoneWorker::~MicrophoneWorker() noexcept {
+    Stop();
+}
+
+void MicrophoneWorker::Stop() noexcept {
+    _stopping.store(true, std::memory_order_relaxed);
+
+    if (_captureThread) {
+        sthread_join(_captureThread);
+        _captureThread = nullptr;
+    }
+
+    if (_analysisThread) {
+        sthread_join(_analysisThread);
+        _analysisThread = nullptr;
+    }
+}
+
+void MicrophoneWorker::CaptureMain(void* userdata) {
+    MicrophoneWorker& worker = *static_cast<MicrophoneWorker*>(userdata);
+    std::array<int16_t, SAMPLES_PER_FRAME> buffer {};
+
+    // Some frontends always fill the buffer (with silence, if the mic is inactive),
+    // so reads are paced by how many samples the mic could have recorded since capture started
+    auto start = std::chrono::steady_clock::now();
+    uint64_t captured = 0;
+    while (!worker._stopping.load(std::memory_order_relaxed)) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        uint64_t due = static_cast<uint64_t>(elapsed.count()) * worker._rate / 1000000;
+        if (due <= captured) {
+            retro_sleep(CAPTURE_INTERVAL_MS);
+            continue;
+        }
+
+        // After the frontend's fallen behind, don't catch up on more than the ring could hold anyway
+        captured = std::max(captured, due - std::min<uint64_t>(due, MIC_RING_SIZE));
+
+        size_t wanted = static_cast<size_t>(std::min<uint64_t>(due - captured, buffer.size()));
+        int samplesRead = worker._interface.read_mic(worker._microphone, buffer.data(), wanted);
+        if (samplesRead > 0) {
+            worker._samples.Write({ buffer.data(), static_cast<size_t>(samplesRead) });
+            captured += static_cast<uint64_t>(samplesRead);
+        }
+
+        if (samplesRead < static_cast<int>(wanted)) {
+            // Drained whatever the frontend had; give it time to collect more
+            retro_sleep(CAPTURE_INTERVAL_MS);
+        }
+    }
+}
+
+void MicrophoneWorker::AnalysisMain(void* userdata) {
+    MicrophoneWorker& worker = *static_cast<MicrophoneWorker*>(userdata);
+    std::array<int16_t, SAMPLES_PER_FRAME> buffer {};
+
+    while (!worker._stopping.load(std::memory_order_relaxed)) {
+        size_t count = worker._samples.Read(buffer);
+        if (count > 0) {
+            worker._detector.Push({ buffer.data(), count });
+            worker._blowing.store(worker._detector.IsBlowing(), std::memory_order_release);
+        } else {
+            retro_sleep(ANALYSIS_INTERVAL_MS);
+        }
+    }
+}
+#endif
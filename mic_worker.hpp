@@ -0,0 +1,51 @@
+#pragma once
+
+#ifdef HAVE_THREADS
+#include <atomic>
+#include <cstdint>
+
+#include <libretro.h>
+#include <rthreads/rthreads.h>
+
+#include "blow.hpp"
+#include "spsc_ring.hpp"
+
+// About 185ms of audio at SAMPLE_RATE; if analysis falls further behind than that, new samples are dropped
+static constexpr size_t MIC_RING_SIZE = 8192;
+
+// Reads the microphone and runs blow detection on two background threads,
+// so that the emulation thread never waits on the frontend's mic backend or pays for the FFT.
+// The capture thread hands samples to the analysis thread through a wait-free ring,
+// and the analysis thread publishes each decision through an atomic flag.
+class MicrophoneWorker {
+public:
+    // The microphone must already be open and enabled, and must stay open until the worker is destroyed.
+    MicrophoneWorker(const retro_microphone_interface& interface, retro_microphone_t* microphone, const BlowDetectorArgs& args = {});
+    ~MicrophoneWorker() noexcept;
+    MicrophoneWorker(const MicrophoneWorker&) = delete;
+    MicrophoneWorker& operator=(const MicrophoneWorker&) = delete;
+    MicrophoneWorker(MicrophoneWorker&&) = delete;
+    MicrophoneWorker& operator=(MicrophoneWorker&&) = delete;
+
+    // The latest decision made by the analysis thread; never blocks
+    [[nodiscard]] bool IsBlowing() const noexcept { return _blowing.load(std::memory_order_acquire); }
+
+    // False if the threads couldn't be started, in which case the caller should analyze samples itself
+    [[nodiscard]] bool IsRunning() const noexcept { return _captureThread && _analysisThread; }
+
+private:
+    retro_microphone_interface _interface;
+    retro_microphone_t* _microphone;
+    unsigned _rate = SAMPLE_RATE; // The rate the frontend actually opened the mic at
+    BlowDetector _detector; // Only touched by the analysis thread
+    SpscRing<int16_t, MIC_RING_SIZE> _samples;
+    std::atomic<bool> _blowing {false};
+    std::atomic<bool> _stopping {false};
+    sthread_t* _captureThread = nullptr;
+    sthread_t* _analysisThread = nullptr;
+
+    static void CaptureMain(void* worker);
+    static void AnalysisMain(void* worker);
+    void Stop() noexcept;
+};
+#endif
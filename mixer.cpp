@@ -0,0 +1,155 @@
+#include "mixer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <audio/audio_resampler.h>
+#include <audio/conversion/float_to_s16.h>
+#include <formats/rwav.h>
+
+#include "constants.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ROMCLEANER_MIXER_SSE2
+#include <emmintrin.h>
+#elif defined(HAVE_NEON)
+#define ROMCLEANER_MIXER_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+    // Converts 8-bit unsigned or 16-bit signed PCM, mono or stereo, to interleaved stereo floats
+    std::vector<float> ToStereoFloat(const rwav_t& wav) {
+        std::vector<float> pcm(static_cast<size_t>(wav.numsamples) * 2);
+        for (size_t frame = 0; frame < wav.numsamples; ++frame) {
+            for (size_t channel = 0; channel < 2; ++channel) {
+                size_t source = frame * wav.numchannels + std::min<size_t>(channel, wav.numchannels - 1);
+                float sample = (wav.bitspersample == 8)
+                    ? (static_cast<const uint8_t*>(wav.samples)[source] - 128) / 128.0f
+                    : static_cast<const int16_t*>(wav.samples)[source] / 32768.0f;
+                pcm[frame * 2 + channel] = sample;
+            }
+        }
+
+        return pcm;
+    }
+
+    // Runs the whole sound through the same sinc resampler that audio_mixer would use on every play
+    std::vector<float> Resample(const std::vector<float>& pcm, unsigned sourceRate) {
+        double ratio = static_cast<double>(SAMPLE_RATE) / sourceRate;
+        void* resampler = nullptr;
+        const retro_resampler_t* backend = nullptr;
+        if (!retro_resampler_realloc(&resampler, &backend, "sinc", RESAMPLER_QUALITY_HIGHER, ratio))
+            return {};
+
+        // The resampler sometimes produces a few more frames than the ratio suggests
+        std::vector<float> resampled(static_cast<size_t>(pcm.size() * ratio) + 16);
+
+        resampler_data data {};
+        data.data_in = pcm.data();
+        data.data_out = resampled.data();
+        data.input_frames = pcm.size() / 2;
+        data.ratio = ratio;
+        backend->process(resampler, &data);
+        backend->free(resampler);
+
+        resampled.resize(std::min(resampled.size(), data.output_frames * 2));
+        return resampled;
+    }
+}
+
+Sound::Sound(nonstd::span<const uint8_t> wav) noexcept {
+    rwav_t decoded {};
+    if (rwav_load(&decoded, wav.data(), wav.size()) != RWAV_ITERATE_DONE)
+        return;
+
+    unsigned sourceRate = decoded.samplerate;
+    bool supported = decoded.numchannels >= 1 && (decoded.bitspersample == 8 || decoded.bitspersample == 16);
+    std::vector<float> pcm = supported ? ToStereoFloat(decoded) : std::vector<float>();
+    rwav_free(&decoded);
+
+    if (pcm.empty() || sourceRate == 0)
+        return;
+
+    if (sourceRate != SAMPLE_RATE) {
+        pcm = Resample(pcm, sourceRate);
+    }
+
+    _samples.resize(pcm.size());
+    convert_float_to_s16(_samples.data(), pcm.data(), pcm.size());
+}
+
+void MixSaturating(int16_t* dst, const int16_t* src, size_t count) noexcept {
+    size_t i = 0;
+#if defined(ROMCLEANER_MIXER_SSE2)
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_adds_epi16(a, b));
+    }
+#elif defined(ROMCLEANER_MIXER_NEON)
+    for (; i + 8 <= count; i += 8) {
+        vst1q_s16(dst + i, vqaddq_s16(vld1q_s16(dst + i), vld1q_s16(src + i)));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        int sum = dst[i] + src[i];
+        dst[i] = static_cast<int16_t>(std::clamp(sum, INT16_MIN, INT16_MAX));
+    }
+}
+
+AudioMixer::Voice AudioMixer::Play(const Sound& sound) noexcept {
+    if (sound.IsEmpty())
+        return NO_VOICE;
+
+    for (size_t i = 0; i < _voices.size(); ++i) {
+        if (_voices[i].sound == nullptr) {
+            _voices[i] = { &sound, 0 };
+            ++_activeCount;
+            return static_cast<Voice>(i);
+        }
+    }
+
+    return NO_VOICE;
+}
+
+void AudioMixer::Stop(Voice voice) noexcept {
+    if (voice < 0 || static_cast<size_t>(voice) >= _voices.size() || _voices[voice].sound == nullptr)
+        return;
+
+    _voices[voice] = {};
+    --_activeCount;
+}
+
+bool AudioMixer::Mix(nonstd::span<int16_t> output) noexcept {
+    if (_activeCount == 0)
+        return false;
+
+    // The first voice is copied rather than added, so the buffer never needs clearing first
+    size_t written = 0;
+    for (VoiceState& voice : _voices) {
+        if (voice.sound == nullptr)
+            continue;
+
+        nonstd::span<const int16_t> samples = voice.sound->GetSamples();
+        size_t count = std::min(output.size(), samples.size() - voice.position);
+        const int16_t* source = samples.data() + voice.position;
+
+        size_t copied = std::min(count, written);
+        MixSaturating(output.data(), source, copied);
+        if (count > written) {
+            memcpy(output.data() + written, source + written, (count - written) * sizeof(int16_t));
+            written = count;
+        }
+
+        voice.position += count;
+        if (voice.position >= samples.size()) {
+            voice = {};
+            --_activeCount;
+        }
+    }
+
+    std::fill(output.begin() + written, output.end(), 0);
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <nonstd/span.hpp>
+
+// A sound decoded ahead of time into interleaved stereo s16 at SAMPLE_RATE,
+// so that playing it is nothing more than copying (or adding) samples.
+class Sound {
+public:
+    // Decodes a WAV file, resampling it if its rate isn't SAMPLE_RATE.
+    // Leaves the sound empty if the file can't be decoded.
+    explicit Sound(nonstd::span<const uint8_t> wav) noexcept;
+
+    [[nodiscard]] bool IsEmpty() const noexcept { return _samples.empty(); }
+    [[nodiscard]] nonstd::span<const int16_t> GetSamples() const noexcept { return _samples; }
+
+private:
+    std::vector<int16_t> _samples;
+};
+
+// Adds src to dst, clamping each sum to the range of int16_t.
+void MixSaturating(int16_t* dst, const int16_t* src, size_t count) noexcept;
+
+// Plays sounds directly in the frontend's output format.
+// Never allocates, and does no work at all while nothing is playing.
+class AudioMixer {
+public:
+    using Voice = int;
+    static constexpr Voice NO_VOICE = -1;
+
+    // Starts playing the sound from the beginning; it must outlive the voice.
+    // Returns NO_VOICE if every voice is busy.
+    Voice Play(const Sound& sound) noexcept;
+
+    // Does nothing if the voice is already free.
+    void Stop(Voice voice) noexcept;
+
+    [[nodiscard]] bool IsSilent() const noexcept { return _activeCount == 0; }
+
+    // Writes the next output.size() / 2 stereo frames of every playing voice into output.
+    // Returns false without touching output if nothing is playing.
+    bool Mix(nonstd::span<int16_t> output) noexcept;
+
+private:
+    static constexpr size_t MAX_VOICES = 4;
+
+    struct VoiceState {
+        const Sound* sound = nullptr; // Null if the voice is free
+        size_t position = 0;          // In samples, not frames
+    };
+
+    std::array<VoiceState, MAX_VOICES> _voices {};
+    size_t _activeCount = 0;
+};
@@ -0,0 +1,187 @@
+#include "options.hpp"
+
+#include <cstdlib>
+
+#include <string/stdstring.h>
+
+namespace {
+    retro_core_option_v2_category CATEGORIES[] = {
+        { nullptr, nullptr, nullptr },
+    };
+
+    retro_core_option_v2_definition DEFINITIONS[] = {
+        {
+            OPTION_DETERMINISTIC,
+            "Deterministic Simulation",
+            nullptr,
+            "Derive all randomness from one fixed seed, so that every session plays out identically. "
+            "Meant for benchmarking and debugging. Takes effect when content is loaded.",
+            nullptr,
+            nullptr,
+            {
+                { "disabled", nullptr },
+                { "enabled", nullptr },
+                { nullptr, nullptr },
+            },
+            "disabled"
+        },
+        {
+            OPTION_RENDER_THREADS,
+            "Render Threads",
+            nullptr,
+            "How many threads draw the screen. "
+            "\"Auto\" uses one per CPU core. Has no effect on builds without thread support.",
+            nullptr,
+            nullptr,
+            {
+                { "auto", "Auto" },
+                { "1", nullptr },
+                { "2", nullptr },
+                { "3", nullptr },
+                { "4", nullptr },
+                { "6", nullptr },
+                { "8", nullptr },
+                { nullptr, nullptr },
+            },
+            "auto"
+        },
+        {
+            OPTION_MIC_THREAD,
+            "Background Microphone Analysis",
+            nullptr,
+            "Read and analyze the microphone on separate threads, so a slow microphone never holds up a frame. "
+            "Only if the frontend's microphone driver can be read from any thread. "
+            "Ignored in deterministic mode and on builds without thread support. Takes effect when the microphone opens.",
+            nullptr,
+            nullptr,
+            {
+                { "disabled", nullptr },
+                { "enabled", nullptr },
+                { nullptr, nullptr },
+            },
+            "disabled"
+        },
+        {
+            OPTION_RESOLUTION,
+            "Internal Resolution",
+            nullptr,
+            "Draw at a lower resolution and let the frontend scale it up, which cuts the cost of drawing on slow devices. "
+            "Takes effect when content is loaded.",
+            nullptr,
+            nullptr,
+            {
+                { "native", "Native (1366x768)" },
+                { "half", "1/2 (683x384)" },
+                { "third", "1/3 (455x256)" },
+                { "640x360", "640x360" },
+                { nullptr, nullptr },
+            },
+            "native"
+        },
+        {
+            OPTION_FRAME_RATE,
+            "Frame Rate",
+            nullptr,
+            "How often the frontend runs the core. 30 FPS halves the cost of drawing on slow devices; "
+            "everything still moves at the same speed. Takes effect when content is loaded.",
+            nullptr,
+            nullptr,
+            {
+                { "60", "60 FPS" },
+                { "30", "30 FPS" },
+                { nullptr, nullptr },
+            },
+            "60"
+        },
+#ifdef HAVE_PROFILER
+        {
+            OPTION_PROFILER_OVERLAY,
+            "Profiler Overlay",
+            nullptr,
+            "Chart how long each part of the last frame took, against the frame's time budget.",
+            nullptr,
+            nullptr,
+            {
+                { "disabled", nullptr },
+                { "enabled", nullptr },
+                { nullptr, nullptr },
+            },
+            "disabled"
+        },
+#endif
+        { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, {{ nullptr, nullptr }}, nullptr },
+    };
+
+    retro_core_options_v2 OPTIONS = { CATEGORIES, DEFINITIONS };
+
+    // For frontends that predate core options; the first value listed is the default
+    retro_variable VARIABLES[] = {
+        { OPTION_DETERMINISTIC, "Deterministic Simulation; disabled|enabled" },
+        { OPTION_RENDER_THREADS, "Render Threads; auto|1|2|3|4|6|8" },
+        { OPTION_MIC_THREAD, "Background Microphone Analysis; disabled|enabled" },
+        { OPTION_RESOLUTION, "Internal Resolution; native|half|third|640x360" },
+        { OPTION_FRAME_RATE, "Frame Rate; 60|30" },
+#ifdef HAVE_PROFILER
+        { OPTION_PROFILER_OVERLAY, "Profiler Overlay; disabled|enabled" },
+#endif
+        { nullptr, nullptr },
+    };
+
+    const char* GetVariable(retro_environment_t environment, const char* key) noexcept {
+        retro_variable variable { key, nullptr };
+        if (!environment(RETRO_ENVIRONMENT_GET_VARIABLE, &variable))
+            return nullptr;
+
+        return variable.value;
+    }
+}
+
+void RegisterCoreOptions(retro_environment_t environment) noexcept {
+    unsigned version = 0;
+    if (environment(RETRO_ENVIRONMENT_GET_CORE_OPTIONS_VERSION, &version) && version >= 2) {
+        environment(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_V2, &OPTIONS);
+    } else {
+        environment(RETRO_ENVIRONMENT_SET_VARIABLES, VARIABLES);
+    }
+}
+
+CoreOptions ReadCoreOptions(retro_environment_t environment) noexcept {
+    CoreOptions options;
+
+    if (const char* value = GetVariable(environment, OPTION_DETERMINISTIC)) {
+        options.deterministic = string_is_equal(value, "enabled");
+    }
+
+    if (const char* value = GetVariable(environment, OPTION_RENDER_THREADS)) {
+        // "auto" (or anything else that isn't a number) parses as 0
+        options.renderThreads = static_cast<unsigned>(strtoul(value, nullptr, 10));
+    }
+
+    if (const char* value = GetVariable(environment, OPTION_MIC_THREAD)) {
+        options.micThread = string_is_equal(value, "enabled");
+    }
+
+    if (const char* value = GetVariable(environment, OPTION_RESOLUTION)) {
+        if (string_is_equal(value, "half")) {
+            options.resolution = RenderResolution::Half;
+        } else if (string_is_equal(value, "third")) {
+            options.resolution = RenderResolution::Third;
+        } else if (string_is_equal(value, "640x360")) {
+            options.resolution = RenderResolution::Fixed640x360;
+        } else {
+            options.resolution = RenderResolution::Native;
+        }
+    }
+
+    if (const char* value = GetVariable(environment, OPTION_FRAME_RATE)) {
+        options.frameRate = string_is_equal(value, "30") ? MIN_FPS : FPS;
+    }
+
+#ifdef HAVE_PROFILER
+    if (const char* value = GetVariable(environment, OPTION_PROFILER_OVERLAY)) {
+        options.profilerOverlay = string_is_equal(value, "enabled");
+    }
+#endif
+
+    return options;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <libretro.h>
+
+#include "constants.hpp"
+
+// Keys of the core's options, as the frontend stores them
+constexpr const char* OPTION_DETERMINISTIC = "romcleaner_deterministic";
+constexpr const char* OPTION_RENDER_THREADS = "romcleaner_render_threads";
+constexpr const char* OPTION_MIC_THREAD = "romcleaner_mic_thread";
+constexpr const char* OPTION_PROFILER_OVERLAY = "romcleaner_profiler_overlay";
+constexpr const char* OPTION_RESOLUTION = "romcleaner_resolution";
+constexpr const char* OPTION_FRAME_RATE = "romcleaner_frame_rate";
+
+// The size of the framebuffer the core draws into; the frontend scales it up to fit the screen
+enum class RenderResolution {
+    Native, // SCREEN_WIDTH x SCREEN_HEIGHT
+    Half,
+    Third,
+    Fixed640x360,
+};
+
+// The core's options, as parsed from the frontend's variables.
+// Anything the frontend doesn't report keeps its default.
+struct CoreOptions {
+    // Seed every random effect from one fixed value, so that runs can be compared frame-for-frame
+    bool deterministic = false;
+
+    // How many threads draw the screen, counting the main thread; 0 picks one per CPU core
+    unsigned renderThreads = 0;
+
+    // Read and analyze the microphone on background threads instead of during retro_run
+    bool micThread = false;
+
+    // Chart each frame's timings in the corner of the screen; only offered by builds with HAVE_PROFILER
+    bool profilerOverlay = false;
+
+    RenderResolution resolution = RenderResolution::Native;
+
+    // How many frames per second the core asks the frontend for; FPS or MIN_FPS.
+    // The simulation still advances at SIMULATION_RATE, so motion is the same speed either way.
+    double frameRate = FPS;
+};
+
+// Declares the core's options to the frontend, with the richest API it supports.
+void RegisterCoreOptions(retro_environment_t environment) noexcept;
+
+[[nodiscard]] CoreOptions ReadCoreOptions(retro_environment_t environment) noexcept;
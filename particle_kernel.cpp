@@ -0,0 +1,178 @@
+#include "particle_kernel.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ROMCLEANER_PARTICLES_SSE2
+#include <emmintrin.h>
+#elif defined(HAVE_NEON) && defined(__aarch64__)
+// 32-bit NEON has no vector sqrt or divide, so it takes the scalar path
+#define ROMCLEANER_PARTICLES_NEON
+#include <arm_neon.h>
+#endif
+
+// Each variant does the same thing per particle:
+// age it, and if it's still alive shrink its speed by deceleration * dt (never below zero),
+// then move it by its new velocity. Positions are kept at sub-pixel precision.
+
+#if defined(__AVX__)
+bool UpdateParticles(const ParticleStreams& streams, size_t count, float dt) noexcept {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 tiny = _mm256_set1_ps(FLT_MIN);
+    const __m256 step = _mm256_set1_ps(dt);
+    __m256 changed = zero;
+
+    for (size_t i = 0; i < count; i += 8) {
+        __m256 ttl = _mm256_loadu_ps(streams.timeToLive + i);
+        __m256 wasAlive = _mm256_cmp_ps(ttl, zero, _CMP_GT_OQ);
+        ttl = _mm256_sub_ps(ttl, _mm256_and_ps(wasAlive, step));
+        _mm256_storeu_ps(streams.timeToLive + i, ttl);
+
+        __m256 alive = _mm256_cmp_ps(ttl, zero, _CMP_GT_OQ);
+
+        __m256 vx = _mm256_loadu_ps(streams.velocityX + i);
+        __m256 vy = _mm256_loadu_ps(streams.velocityY + i);
+        __m256 speed = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)));
+        __m256 decel = _mm256_mul_ps(_mm256_loadu_ps(streams.deceleration + i), step);
+        __m256 newSpeed = _mm256_max_ps(zero, _mm256_sub_ps(speed, decel));
+        __m256 scale = _mm256_div_ps(newSpeed, _mm256_max_ps(speed, tiny));
+
+        vx = _mm256_blendv_ps(vx, _mm256_mul_ps(vx, scale), alive);
+        vy = _mm256_blendv_ps(vy, _mm256_mul_ps(vy, scale), alive);
+        _mm256_storeu_ps(streams.velocityX + i, vx);
+        _mm256_storeu_ps(streams.velocityY + i, vy);
+
+        __m256 px = _mm256_loadu_ps(streams.positionX + i);
+        __m256 py = _mm256_loadu_ps(streams.positionY + i);
+        px = _mm256_add_ps(px, _mm256_and_ps(alive, _mm256_mul_ps(vx, step)));
+        py = _mm256_add_ps(py, _mm256_and_ps(alive, _mm256_mul_ps(vy, step)));
+        _mm256_storeu_ps(streams.positionX + i, px);
+        _mm256_storeu_ps(streams.positionY + i, py);
+
+        __m256 died = _mm256_andnot_ps(alive, wasAlive);
+        __m256 moved = _mm256_and_ps(alive, _mm256_cmp_ps(newSpeed, zero, _CMP_GT_OQ));
+        changed = _mm256_or_ps(changed, _mm256_or_ps(died, moved));
+    }
+
+    return _mm256_movemask_ps(changed) != 0;
+}
+#elif defined(ROMCLEANER_PARTICLES_SSE2)
+bool UpdateParticles(const ParticleStreams& streams, size_t count, float dt) noexcept {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 tiny = _mm_set1_ps(FLT_MIN);
+    const __m128 step = _mm_set1_ps(dt);
+    __m128 changed = zero;
+
+    for (size_t i = 0; i < count; i += 4) {
+        __m128 ttl = _mm_loadu_ps(streams.timeToLive + i);
+        __m128 wasAlive = _mm_cmpgt_ps(ttl, zero);
+        ttl = _mm_sub_ps(ttl, _mm_and_ps(wasAlive, step));
+        _mm_storeu_ps(streams.timeToLive + i, ttl);
+
+        __m128 alive = _mm_cmpgt_ps(ttl, zero);
+
+        __m128 vx = _mm_loadu_ps(streams.velocityX + i);
+        __m128 vy = _mm_loadu_ps(streams.velocityY + i);
+        __m128 speed = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)));
+        __m128 decel = _mm_mul_ps(_mm_loadu_ps(streams.deceleration + i), step);
+        __m128 newSpeed = _mm_max_ps(zero, _mm_sub_ps(speed, decel));
+        __m128 scale = _mm_div_ps(newSpeed, _mm_max_ps(speed, tiny));
+
+        // SSE2 has no blend instruction, so select with and/andnot/or
+        vx = _mm_or_ps(_mm_and_ps(alive, _mm_mul_ps(vx, scale)), _mm_andnot_ps(alive, vx));
+        vy = _mm_or_ps(_mm_and_ps(alive, _mm_mul_ps(vy, scale)), _mm_andnot_ps(alive, vy));
+        _mm_storeu_ps(streams.velocityX + i, vx);
+        _mm_storeu_ps(streams.velocityY + i, vy);
+
+        __m128 px = _mm_loadu_ps(streams.positionX + i);
+        __m128 py = _mm_loadu_ps(streams.positionY + i);
+        px = _mm_add_ps(px, _mm_and_ps(alive, _mm_mul_ps(vx, step)));
+        py = _mm_add_ps(py, _mm_and_ps(alive, _mm_mul_ps(vy, step)));
+        _mm_storeu_ps(streams.positionX + i, px);
+        _mm_storeu_ps(streams.positionY + i, py);
+
+        __m128 died = _mm_andnot_ps(alive, wasAlive);
+        __m128 moved = _mm_and_ps(alive, _mm_cmpgt_ps(newSpeed, zero));
+        changed = _mm_or_ps(changed, _mm_or_ps(died, moved));
+    }
+
+    return _mm_movemask_ps(changed) != 0;
+}
+#elif defined(ROMCLEANER_PARTICLES_NEON)
+bool UpdateParticles(const ParticleStreams& streams, size_t count, float dt) noexcept {
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t tiny = vdupq_n_f32(FLT_MIN);
+    const float32x4_t step = vdupq_n_f32(dt);
+    uint32x4_t changed = vdupq_n_u32(0);
+
+    for (size_t i = 0; i < count; i += 4) {
+        float32x4_t ttl = vld1q_f32(streams.timeToLive + i);
+        uint32x4_t wasAlive = vcgtq_f32(ttl, zero);
+        ttl = vsubq_f32(ttl, vbslq_f32(wasAlive, step, zero));
+        vst1q_f32(streams.timeToLive + i, ttl);
+
+        uint32x4_t alive = vcgtq_f32(ttl, zero);
+
+        float32x4_t vx = vld1q_f32(streams.velocityX + i);
+        float32x4_t vy = vld1q_f32(streams.velocityY + i);
+        float32x4_t speed = vsqrtq_f32(vaddq_f32(vmulq_f32(vx, vx), vmulq_f32(vy, vy)));
+        float32x4_t decel = vmulq_f32(vld1q_f32(streams.deceleration + i), step);
+        float32x4_t newSpeed = vmaxq_f32(zero, vsubq_f32(speed, decel));
+        float32x4_t scale = vdivq_f32(newSpeed, vmaxq_f32(speed, tiny));
+
+        vx = vbslq_f32(alive, vmulq_f32(vx, scale), vx);
+        vy = vbslq_f32(alive, vmulq_f32(vy, scale), vy);
+        vst1q_f32(streams.velocityX + i, vx);
+        vst1q_f32(streams.velocityY + i, vy);
+
+        float32x4_t px = vld1q_f32(streams.positionX + i);
+        float32x4_t py = vld1q_f32(streams.positionY + i);
+        px = vaddq_f32(px, vbslq_f32(alive, vmulq_f32(vx, step), zero));
+        py = vaddq_f32(py, vbslq_f32(alive, vmulq_f32(vy, step), zero));
+        vst1q_f32(streams.positionX + i, px);
+        vst1q_f32(streams.positionY + i, py);
+
+        uint32x4_t died = vbicq_u32(wasAlive, alive);
+        uint32x4_t moved = vandq_u32(alive, vcgtq_f32(newSpeed, zero));
+        changed = vorrq_u32(changed, vorrq_u32(died, moved));
+    }
+
+    return vmaxvq_u32(changed) != 0;
+}
+#else
+bool UpdateParticles(const ParticleStreams& streams, size_t count, float dt) noexcept {
+    bool changed = false;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (streams.timeToLive[i] <= 0.0f)
+            continue;
+
+        streams.timeToLive[i] -= dt;
+        if (streams.timeToLive[i] <= 0.0f) {
+            changed = true;
+            continue;
+        }
+
+        float vx = streams.velocityX[i];
+        float vy = streams.velocityY[i];
+        float speed = std::sqrt(vx * vx + vy * vy);
+        float newSpeed = std::max(0.0f, speed - streams.deceleration[i] * dt);
+        float scale = newSpeed / std::max(speed, FLT_MIN);
+
+        vx *= scale;
+        vy *= scale;
+        streams.velocityX[i] = vx;
+        streams.velocityY[i] = vy;
+        streams.positionX[i] += vx * dt;
+        streams.positionY[i] += vy * dt;
+
+        changed |= newSpeed > 0.0f;
+    }
+
+    return changed;
+}
+#endif
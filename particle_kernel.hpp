@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+// Particle arrays are padded to a multiple of this,
+// so that the update kernel never needs a scalar tail loop.
+constexpr size_t PARTICLE_LANES = 8;
+
+// Raw views of a particle pool's parallel arrays.
+// All arrays must hold at least as many elements as the count given to UpdateParticles.
+struct ParticleStreams {
+    float* positionX;
+    float* positionY;
+    float* velocityX;
+    float* velocityY;
+    float* timeToLive;
+    const float* deceleration;
+};
+
+// Ages, decelerates and moves the first `count` particles (a multiple of PARTICLE_LANES).
+// Particles whose timeToLive is not positive are left untouched.
+// Returns true if any live particle moved or died.
+bool UpdateParticles(const ParticleStreams& streams, size_t count, float dt) noexcept;
@@ -1,195 +1,394 @@
 #include "particles.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <retro_assert.h>
 
 #include <utility>
 
-ParticleSystem::ParticleSystem(nonstd::span<const uint8_t> image, const ParticleSystemArgs& args) noexcept :
-    _args(args),
-    _randomX(args.spawnArea.x, args.spawnArea.x + args.spawnArea.width),
-    _randomY(args.spawnArea.y, args.spawnArea.y + args.spawnArea.height),
-    _randomImage(0, 0) // Initialize with single image range
-{
-    std::vector<nonstd::span<const uint8_t>> images = {image};
-    LoadImages(images);
-    _particles.resize(_args.maxParticles);
-}
+#include "damage.hpp"
+#include "profiler.hpp"
+#include "serialize.hpp"
 
-ParticleSystem::ParticleSystem(nonstd::span<nonstd::span<const uint8_t>> images, const ParticleSystemArgs& args) noexcept :
+// Position x, position y and image for each spawned particle
+static constexpr size_t SPAWN_RANDOM_COUNT = 3;
+
+ParticleSystem::ParticleSystem(const SpriteFrames& frames, const ParticleSystemArgs& args) noexcept :
+    _frames(frames),
     _args(args),
-    _randomX(args.spawnArea.x, args.spawnArea.x + args.spawnArea.width),
-    _randomY(args.spawnArea.y, args.spawnArea.y + args.spawnArea.height)
+    _rng(args.seed)
 {
-    LoadImages(images);
-    _particles.resize(_args.maxParticles);
-}
+    retro_assert(_frames.atlas != nullptr);
+    retro_assert(_frames.count > 0);
+    retro_assert(_frames.first + _frames.count <= _frames.atlas->GetFrameCount());
 
-void ParticleSystem::LoadImages(nonstd::span<nonstd::span<const uint8_t>> images) {
-    retro_assert(!images.empty());
-    
-    for (const auto& image : images) {
-        pntr_image* img = pntr_load_image_from_memory(PNTR_IMAGE_TYPE_PNG, image.data(), image.size());
-        retro_assert(img != nullptr);
-        _images.push_back(img);
-    }
-    
-    // Initialize the random distribution for selecting images
-    _randomImage = std::uniform_int_distribution<size_t>(0, _images.size() - 1);
+    _particles.Resize(_args.maxParticles);
+    _spawnRandom.resize(_args.maxParticles * SPAWN_RANDOM_COUNT);
 }
 
 ParticleSystem::ParticleSystem(ParticleSystem&& other) noexcept :
-    _images(std::move(other._images)),
+    _frames(other._frames),
     _particles(std::move(other._particles)),
     _args(other._args),
     _rng(other._rng),
-    _randomX(other._randomX),
-    _randomY(other._randomY),
-    _randomImage(other._randomImage)
+    _spawnRandom(std::move(other._spawnRandom)),
+    _spawning(other._spawning),
+    _changed(other._changed),
+    _renderLead(other._renderLead),
+    _drawnBounds(other._drawnBounds),
+    _grid(other._grid),
+    _binEntries(std::move(other._binEntries)),
+    _binStart(std::move(other._binStart)),
+    _binsDirty(other._binsDirty)
 {
-    // Clear the source images vector without deleting the images
-    other._images.clear();
 }
 
 ParticleSystem& ParticleSystem::operator=(ParticleSystem&& other) noexcept {
     if (this != &other) {
-        // Unload current images
-        for (auto* img : _images) {
-            if (img) {
-                pntr_unload_image(img);
-            }
-        }
-        
-        _images = std::move(other._images);
+        _frames = other._frames;
         _particles = std::move(other._particles);
         _args = other._args;
         _rng = other._rng;
-        _randomX = other._randomX;
-        _randomY = other._randomY;
-        _randomImage = other._randomImage;
-
-        other._images.clear();
+        _spawnRandom = std::move(other._spawnRandom);
+        _spawning = other._spawning;
+        _changed = other._changed;
+        _renderLead = other._renderLead;
+        _drawnBounds = other._drawnBounds;
+        _grid = other._grid;
+        _binEntries = std::move(other._binEntries);
+        _binStart = std::move(other._binStart);
+        _binsDirty = other._binsDirty;
     }
     return *this;
 }
 
-ParticleSystem::~ParticleSystem() noexcept {
-    for (auto* img : _images) {
-        if (img) {
-            pntr_unload_image(img);
+ParticleSystem::~ParticleSystem() noexcept = default;
+
+void ParticleSystem::SetSpawnArea(pntr_rectangle area) noexcept {
+    _args.spawnArea = area;
+}
+
+void ParticlePool::Resize(size_t capacity) {
+    size_t padded = (capacity + PARTICLE_LANES - 1) / PARTICLE_LANES * PARTICLE_LANES;
+
+    positionX.assign(padded, 0.0f);
+    positionY.assign(padded, 0.0f);
+    velocityX.assign(padded, 0.0f);
+    velocityY.assign(padded, 0.0f);
+    timeToLive.assign(padded, 0.0f);
+    deceleration.assign(padded, 0.0f);
+    imageIndex.assign(padded, 0);
+    liveCount = 0;
+    maxLive = capacity;
+}
+
+size_t ParticlePool::RemoveDead() noexcept {
+    size_t removed = 0;
+    size_t i = 0;
+    while (i < liveCount) {
+        if (timeToLive[i] > 0.0f) {
+            ++i;
+            continue;
         }
+
+        // Move the last live particle into this slot and look at it again
+        size_t last = --liveCount;
+        positionX[i] = positionX[last];
+        positionY[i] = positionY[last];
+        velocityX[i] = velocityX[last];
+        velocityY[i] = velocityY[last];
+        timeToLive[i] = timeToLive[last];
+        deceleration[i] = deceleration[last];
+        imageIndex[i] = imageIndex[last];
+
+        // The kernel may still process the vacated slot as padding, so make sure it's dead
+        timeToLive[last] = 0.0f;
+        ++removed;
     }
-    _images.clear();
+
+    return removed;
 }
 
-void ParticleSystem::SetSpawnArea(pntr_rectangle area) noexcept {
-    _args.spawnArea = area;
-    UpdateSpawnArea();
+void ParticlePool::Serialize(StateWriter& writer) const noexcept {
+    writer.WriteSize(liveCount);
+    writer.WriteArray(nonstd::span<const float>(positionX.data(), maxLive));
+    writer.WriteArray(nonstd::span<const float>(positionY.data(), maxLive));
+    writer.WriteArray(nonstd::span<const float>(velocityX.data(), maxLive));
+    writer.WriteArray(nonstd::span<const float>(velocityY.data(), maxLive));
+    writer.WriteArray(nonstd::span<const float>(timeToLive.data(), maxLive));
+    writer.WriteArray(nonstd::span<const float>(deceleration.data(), maxLive));
+    writer.WriteArray(nonstd::span<const uint32_t>(imageIndex.data(), maxLive));
+}
+
+bool ParticlePool::Unserialize(StateReader& reader) noexcept {
+    size_t count = 0;
+    if (!reader.ReadSize(count) || count > maxLive) {
+        reader.Fail();
+        return false;
+    }
+
+    liveCount = count;
+    reader.ReadArray(nonstd::span<float>(positionX.data(), maxLive));
+    reader.ReadArray(nonstd::span<float>(positionY.data(), maxLive));
+    reader.ReadArray(nonstd::span<float>(velocityX.data(), maxLive));
+    reader.ReadArray(nonstd::span<float>(velocityY.data(), maxLive));
+    reader.ReadArray(nonstd::span<float>(timeToLive.data(), maxLive));
+    reader.ReadArray(nonstd::span<float>(deceleration.data(), maxLive));
+    reader.ReadArray(nonstd::span<uint32_t>(imageIndex.data(), maxLive));
+
+    // Slots past the live range must stay dead, or the kernel would revive them
+    std::fill(timeToLive.begin() + liveCount, timeToLive.end(), 0.0f);
+
+    return reader.IsOk();
+}
+
+ParticleStreams ParticlePool::GetStreams() noexcept {
+    return {
+        positionX.data(),
+        positionY.data(),
+        velocityX.data(),
+        velocityY.data(),
+        timeToLive.data(),
+        deceleration.data(),
+    };
 }
 
-void ParticleSystem::UpdateSpawnArea() {
-    _randomX = std::uniform_int_distribution(_args.spawnArea.x, _args.spawnArea.x + _args.spawnArea.width);
-    _randomY = std::uniform_int_distribution(_args.spawnArea.y, _args.spawnArea.y + _args.spawnArea.height);
+// Particles are positioned with sub-pixel precision, but drawn on whole pixels
+static int ToPixel(float coordinate) noexcept {
+    return static_cast<int>(std::floor(coordinate));
 }
 
 void ParticleSystem::EmitParticle(double max) {
-    // Find an inactive particle
-    size_t particlesSpawned = 0;
-    for (Particle& p : _particles) {
-        if (particlesSpawned >= max)
-            break;
-
-        if (!p.alive) {
-            // Set position
-            p.position.x = _randomX(_rng);
-            p.position.y = _randomY(_rng);
-
-            // Calculate the normalized position within spawn area (0.0 = left edge, 1.0 = right edge)
-            double normalizedX = 0.5; // Default to middle
-            if (_args.spawnArea.width > 0) {
-                normalizedX = static_cast<double>(p.position.x - _args.spawnArea.x) / _args.spawnArea.width;
-            }
-            
-            // Calculate the angle offset based on position (-edgeAngleOffset at left, +edgeAngleOffset at right)
-            // Map from [0,1] to [-1,1], then multiply by the max angle offset
-            double angleOffset = -(normalizedX * 2.0 - 1.0) * _args.edgeAngleOffset;
-            
-            // Convert base velocity to speed and angle
-            double speed = std::sqrt(_args.baseVelocity.x * _args.baseVelocity.x + 
-                                    _args.baseVelocity.y * _args.baseVelocity.y);
-            
-            // Calculate base angle (assuming baseVelocity points down)
-            double baseAngle = std::atan2(_args.baseVelocity.y, _args.baseVelocity.x);
-            
-            // Apply the offset (convert from degrees to radians)
-            double finalAngle = baseAngle + angleOffset * (M_PI / 180.0);
-            
-            // Set velocity based on the calculated angle and speed
-            p.velocity.x = speed * std::cos(finalAngle);
-            p.velocity.y = speed * std::sin(finalAngle);
-            
-            // Set deceleration
-            p.deceleration = _args.deceleration;
-
-            // Set lifetime
-            p.timeToLive = _args.baseTimeToLive;
-            
-            // Assign a random image to this particle
-            p.imageIndex = _randomImage(_rng);
-
-            p.alive = true;
-            ++particlesSpawned;
+    // Convert base velocity to speed and angle
+    double speed = std::sqrt(_args.baseVelocity.x * _args.baseVelocity.x +
+                             _args.baseVelocity.y * _args.baseVelocity.y);
+
+    // Calculate base angle (assuming baseVelocity points down)
+    double baseAngle = std::atan2(_args.baseVelocity.y, _args.baseVelocity.x);
+
+    // Spawning only ever appends to the live range, so this costs nothing per free slot
+    size_t count = std::min<size_t>(std::ceil(max), _particles.FreeCount());
+    if (count == 0)
+        return;
+
+    // Generate every random number this batch needs in one go
+    nonstd::span<uint32_t> random(_spawnRandom.data(), count * SPAWN_RANDOM_COUNT);
+    _rng.Fill(random);
+
+    // The spawn area's edges are both inclusive
+    uint32_t rangeX = static_cast<uint32_t>(std::max(0, _args.spawnArea.width)) + 1;
+    uint32_t rangeY = static_cast<uint32_t>(std::max(0, _args.spawnArea.height)) + 1;
+
+    for (size_t n = 0; n < count; ++n) {
+        size_t i = _particles.Spawn();
+        const uint32_t* r = &random[n * SPAWN_RANDOM_COUNT];
+
+        // Set position
+        int x = _args.spawnArea.x + static_cast<int>(Rng::Scale(r[0], rangeX));
+        int y = _args.spawnArea.y + static_cast<int>(Rng::Scale(r[1], rangeY));
+        _particles.positionX[i] = x;
+        _particles.positionY[i] = y;
+
+        // Calculate the normalized position within spawn area (0.0 = left edge, 1.0 = right edge)
+        double normalizedX = 0.5; // Default to middle
+        if (_args.spawnArea.width > 0) {
+            normalizedX = static_cast<double>(x - _args.spawnArea.x) / _args.spawnArea.width;
         }
+
+        // Calculate the angle offset based on position (-edgeAngleOffset at left, +edgeAngleOffset at right)
+        // Map from [0,1] to [-1,1], then multiply by the max angle offset
+        double angleOffset = -(normalizedX * 2.0 - 1.0) * _args.edgeAngleOffset;
+
+        // Apply the offset (convert from degrees to radians)
+        double finalAngle = baseAngle + angleOffset * (M_PI / 180.0);
+
+        // Set velocity based on the calculated angle and speed
+        _particles.velocityX[i] = speed * std::cos(finalAngle);
+        _particles.velocityY[i] = speed * std::sin(finalAngle);
+
+        // Set deceleration
+        _particles.deceleration[i] = _args.deceleration;
+
+        // Set lifetime
+        _particles.timeToLive[i] = _args.baseTimeToLive;
+
+        // Assign a random image to this particle
+        _particles.imageIndex[i] = Rng::Scale(r[2], _frames.count);
     }
+
+    _changed |= count > 0;
 }
 
 void ParticleSystem::Update(double dt) {
+    PROFILE_SCOPE(ParticlesUpdate);
+
     // Emit new particles based on emission rate
     if (_spawning) {
         EmitParticle(_args.spawnRate * dt);
     }
 
-    for (Particle& p : _particles) {
-        if (p.alive) {
-            p.timeToLive -= dt;
-            p.alive = p.timeToLive > 0;
+    _changed |= UpdateParticles(_particles.GetStreams(), _particles.KernelCount(), static_cast<float>(dt));
+    _particles.RemoveDead();
+    _binsDirty = true;
+}
+
+void ParticleSystem::SetRenderLead(float seconds) noexcept {
+    if (seconds == _renderLead)
+        return;
+
+    _renderLead = seconds;
+    if (_particles.liveCount > 0) {
+        _changed = true;
+        _binsDirty = true;
+    }
+}
+
+pntr_rectangle ParticleSystem::GetParticleRect(size_t i) const noexcept {
+    uint32_t imageIndex = _particles.imageIndex[i];
+    if (imageIndex >= _frames.count)
+        return {};
+
+    const pntr_rectangle& frame = _frames.atlas->GetFrame(_frames.first + imageIndex).rect;
+    float x = _particles.positionX[i] + _particles.velocityX[i] * _renderLead;
+    float y = _particles.positionY[i] + _particles.velocityY[i] * _renderLead;
+    return { ToPixel(x), ToPixel(y), frame.width, frame.height };
+}
+
+void ParticleSystem::ReserveBins(const TileGrid& grid) {
+    // A particle overlaps at most one more tile in each direction than its frame is wide or tall
+    size_t maxTiles = 1;
+    for (uint32_t i = 0; i < _frames.count; ++i) {
+        const pntr_rectangle& frame = _frames.atlas->GetFrame(_frames.first + i).rect;
+        size_t columns = static_cast<size_t>((frame.width + TILE_SIZE - 2) / TILE_SIZE + 1);
+        size_t rows = static_cast<size_t>((frame.height + TILE_SIZE - 2) / TILE_SIZE + 1);
+        maxTiles = std::max(maxTiles, columns * rows);
+    }
+
+    _binStart.reserve(grid.GetTileCount() + 1);
+    _binEntries.reserve(_args.maxParticles * std::min(maxTiles, grid.GetTileCount()));
+}
+
+void ParticleSystem::Bin(const TileGrid& grid) noexcept {
+    size_t tileCount = grid.GetTileCount();
+    if (!_binsDirty && _grid == &grid && _binStart.size() == tileCount + 1)
+        return;
+
+    _binStart.assign(tileCount + 1, 0);
+
+    // Counting sort: it's stable, so particles within a tile keep their relative draw order.
+    // A particle that straddles tiles goes in each of them; each copy is clipped to its own tile.
+    for (size_t i = 0; i < _particles.liveCount; ++i) {
+        TileSpan span = grid.GetSpan(GetParticleRect(i));
+        for (int row = span.firstRow; row < span.endRow; ++row) {
+            for (int column = span.firstColumn; column < span.endColumn; ++column) {
+                ++_binStart[grid.GetTileIndex(column, row) + 1];
+            }
         }
+    }
+
+    for (size_t t = 0; t < tileCount; ++t) {
+        _binStart[t + 1] += _binStart[t];
+    }
+    _binEntries.resize(_binStart[tileCount]);
+
+    // Use each tile's start as its write cursor; afterwards each one holds the next tile's start
+    for (size_t i = 0; i < _particles.liveCount; ++i) {
+        TileSpan span = grid.GetSpan(GetParticleRect(i));
+        for (int row = span.firstRow; row < span.endRow; ++row) {
+            for (int column = span.firstColumn; column < span.endColumn; ++column) {
+                _binEntries[_binStart[grid.GetTileIndex(column, row)]++] = static_cast<uint32_t>(i);
+            }
+        }
+    }
 
-        if (p.alive) {
-            // Apply deceleration
-            if (p.deceleration > 0) {
-                double currentSpeed = std::sqrt(p.velocity.x * p.velocity.x + p.velocity.y * p.velocity.y);
-                if (currentSpeed > 0) {
-                    // Calculate deceleration for this frame
-                    double decelAmount = p.deceleration * dt;
-                    
-                    // Calculate new speed after deceleration (ensure it doesn't go negative)
-                    double newSpeed = std::max(0.0, currentSpeed - decelAmount);
-                    
-                    // If we still have velocity, rescale the velocity vector
-                    if (newSpeed > 0 && currentSpeed > 0) {
-                        double scale = newSpeed / currentSpeed;
-                        p.velocity.x *= scale;
-                        p.velocity.y *= scale;
-                    } else {
-                        // If velocity becomes zero, stop the particle
-                        p.velocity.x = 0;
-                        p.velocity.y = 0;
-                    }
-                }
+    for (size_t t = tileCount; t > 0; --t) {
+        _binStart[t] = _binStart[t - 1];
+    }
+    _binStart[0] = 0;
+
+    _grid = &grid;
+    _binsDirty = false;
+}
+
+void ParticleSystem::Draw(pntr_image& framebuffer, pntr_rectangle clip) const noexcept {
+    PROFILE_SCOPE(ParticlesDraw);
+
+    if (_particles.liveCount == 0)
+        return;
+
+    retro_assert(!_binsDirty);
+    retro_assert(_grid != nullptr);
+
+    const SpriteAtlas& atlas = *_frames.atlas;
+    TileSpan span = _grid->GetSpan(clip);
+    for (int row = span.firstRow; row < span.endRow; ++row) {
+        for (int column = span.firstColumn; column < span.endColumn; ++column) {
+            // Only draw the part of each particle that's in this tile, so none is blended twice
+            pntr_rectangle tileClip = RectIntersection(clip, _grid->GetTileRect(column, row));
+            size_t tile = _grid->GetTileIndex(column, row);
+            for (uint32_t o = _binStart[tile]; o < _binStart[tile + 1]; ++o) {
+                uint32_t i = _binEntries[o];
+
+                // Drawn exactly where it was binned and damage-tracked, render lead included
+                pntr_rectangle rect = GetParticleRect(i);
+                atlas.Draw(framebuffer, _frames.first + _particles.imageIndex[i], rect.x, rect.y, tileClip);
             }
-            
-            // Update position based on velocity
-            p.position.x += std::round(p.velocity.x * dt);
-            p.position.y += std::round(p.velocity.y * dt);
         }
     }
 }
 
-void ParticleSystem::Draw(pntr_image& framebuffer) {
-    for (const Particle& p : _particles) {
-        if (p.alive && p.imageIndex < _images.size()) {
-            pntr_draw_image(&framebuffer, _images[p.imageIndex], p.position.x, p.position.y);
+pntr_rectangle ParticleSystem::GetBounds() const noexcept {
+    pntr_rectangle bounds {};
+    for (size_t i = 0; i < _particles.liveCount; ++i) {
+        bounds = RectUnion(bounds, GetParticleRect(i));
+    }
+
+    return bounds;
+}
+
+void ParticleSystem::Serialize(StateWriter& writer) const noexcept {
+    _particles.Serialize(writer);
+    writer.Write(_args.spawnArea);
+    writer.Write(_spawning);
+    writer.Write(_rng.GetState());
+}
+
+bool ParticleSystem::Unserialize(StateReader& reader) noexcept {
+    if (!_particles.Unserialize(reader))
+        return false;
+
+    reader.Read(_args.spawnArea);
+    reader.Read(_spawning);
+    Rng::State rngState {};
+    if (reader.Read(rngState) && !_rng.SetState(rngState)) {
+        reader.Fail();
+    }
+
+    for (size_t i = 0; i < _particles.liveCount; ++i) {
+        if (_particles.imageIndex[i] >= _frames.count) {
+            reader.Fail();
         }
     }
+
+    if (!reader.IsOk()) {
+        _particles.Resize(_args.maxParticles);
+        return false;
+    }
+
+    // Whatever was on screen before has nothing to do with the restored particles
+    _changed = true;
+    _binsDirty = true;
+    return true;
+}
+
+void ParticleSystem::ReportDamage(DamageTracker& damage) noexcept {
+    if (!_changed)
+        return;
+
+    // A few hundred tiny sprites are cheaper to track as one bounding box than individually
+    pntr_rectangle bounds = GetBounds();
+    damage.Add(_drawnBounds);
+    damage.Add(bounds);
+    _drawnBounds = bounds;
+    _changed = false;
 }
@@ -1,19 +1,57 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
 #include <pntr.h>
-#include <random>
 
 #include <nonstd/span.hpp>
 
-struct Particle {
-    pntr_vector position {0, 0};
-    pntr_vector velocity {0, 0};
-    double timeToLive = 0.0;
-    bool alive = false;
-    size_t imageIndex = 0;  // Index of the image to use for this particle
-    double deceleration = 0.0; // Deceleration factor for this particle
+#include "atlas.hpp"
+#include "particle_kernel.hpp"
+#include "rng.hpp"
+#include "tiles.hpp"
+
+class DamageTracker;
+class StateReader;
+class StateWriter;
+
+// Particles stored as parallel arrays, so the update kernel can work on several at once.
+// Live particles are kept packed at the front of the arrays:
+// spawning appends at liveCount and a dying particle is replaced by the last live one,
+// so every pass over the pool only touches live particles.
+struct ParticlePool {
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> velocityX;
+    std::vector<float> velocityY;
+    std::vector<float> timeToLive;
+    std::vector<float> deceleration; // Velocity reduction per second
+    std::vector<uint32_t> imageIndex; // Index of the image to use for each particle
+    size_t liveCount = 0;
+    size_t maxLive = 0;
+
+    // Rounds the array length up to a multiple of PARTICLE_LANES;
+    // the extra slots are never spawned into, they just let the kernel skip its tail loop.
+    void Resize(size_t capacity);
+    [[nodiscard]] size_t FreeCount() const noexcept { return maxLive - liveCount; }
+
+    // Returns the index of a new particle slot; the caller must check FreeCount first.
+    [[nodiscard]] size_t Spawn() noexcept { return liveCount++; }
+
+    // Swap-removes every particle whose timeToLive ran out, returning how many were removed.
+    size_t RemoveDead() noexcept;
+
+    // The number of slots the update kernel must process to cover every live particle.
+    [[nodiscard]] size_t KernelCount() const noexcept {
+        return (liveCount + PARTICLE_LANES - 1) / PARTICLE_LANES * PARTICLE_LANES;
+    }
+
+    [[nodiscard]] ParticleStreams GetStreams() noexcept;
+
+    // Writes every slot up to maxLive, live or not, so the state's size never changes.
+    void Serialize(StateWriter& writer) const noexcept;
+    bool Unserialize(StateReader& reader) noexcept;
 };
 
 struct ParticleSystemArgs {
@@ -24,12 +62,14 @@ struct ParticleSystemArgs {
     pntr_rectangle spawnArea;
     double deceleration = 0.0;      // Deceleration factor (velocity reduction per second)
     double edgeAngleOffset = 5.0;   // Maximum angle offset at edges (in degrees)
+    uint64_t seed = 0;              // Systems with the same seed and inputs behave identically
 };
 
 class ParticleSystem {
 public:
-    ParticleSystem(nonstd::span<const uint8_t> image, const ParticleSystemArgs& args) noexcept;
-    ParticleSystem(nonstd::span<nonstd::span<const uint8_t>> images, const ParticleSystemArgs& args) noexcept;
+    // Each particle uses a random frame from the given range.
+    // The atlas is borrowed, and must outlive the particle system.
+    ParticleSystem(const SpriteFrames& frames, const ParticleSystemArgs& args) noexcept;
     
     ~ParticleSystem() noexcept;
     ParticleSystem(ParticleSystem&) = delete;
@@ -38,24 +78,56 @@ public:
     ParticleSystem& operator=(ParticleSystem&& other) noexcept;
 
     void Update(double dt);
-    void Draw(pntr_image& framebuffer);
+
+    // Sorts the live particles into the tiles they overlap.
+    // Must be called after the particles change and before they're drawn;
+    // the grid is borrowed until the next call.
+    void Bin(const TileGrid& grid) noexcept;
+
+    // Sizes the bins for the worst case on this grid, so that binning never has to allocate.
+    void ReserveBins(const TileGrid& grid);
+
+    // Only reads the bins, so separate tiles can be drawn from separate threads at once.
+    void Draw(pntr_image& framebuffer, pntr_rectangle clip) const noexcept;
     void SetSpawnArea(pntr_rectangle area) noexcept;
 
+    // Draws each particle where its current velocity will have taken it this many seconds after the last update.
+    // Lets the renderer catch up with time that has passed but isn't yet a whole simulation step.
+    void SetRenderLead(float seconds) noexcept;
+
     [[nodiscard]] pntr_rectangle GetSpawnArea() const noexcept { return _args.spawnArea; }
     void SetSpawning(bool spawning) noexcept { _spawning = spawning; }
     [[nodiscard]] bool IsSpawning() const noexcept { return _spawning; }
+    [[nodiscard]] size_t GetLiveCount() const noexcept { return _particles.liveCount; }
+    [[nodiscard]] size_t GetFreeCount() const noexcept { return _particles.FreeCount(); }
+
+    // Reports the area covered by the particles when last drawn and the area they cover now,
+    // but only if any particle was spawned, moved or died since then.
+    void ReportDamage(DamageTracker& damage) noexcept;
+
+    // Saves the particles, spawn area and RNG state; the images and other arguments come from the constructor.
+    void Serialize(StateWriter& writer) const noexcept;
+    bool Unserialize(StateReader& reader) noexcept;
 
 private:
-    std::vector<pntr_image*> _images;  // Vector of particle images
-    std::vector<Particle> _particles {};
+    SpriteFrames _frames {};
+    ParticlePool _particles {};
     ParticleSystemArgs _args;
-    std::default_random_engine _rng {std::random_device{}()};
-    std::uniform_int_distribution<> _randomX;
-    std::uniform_int_distribution<> _randomY;
-    std::uniform_int_distribution<size_t> _randomImage;  // For selecting a random image
+    Rng _rng;
+    std::vector<uint32_t> _spawnRandom; // Random numbers for one frame's worth of spawns, generated in bulk
     bool _spawning = false;
+    bool _changed = false;
+    float _renderLead = 0.0f;
+    pntr_rectangle _drawnBounds {};
+
+    // Live particle indices bucketed by the tiles they overlap,
+    // so that drawing a tile only visits the particles that are in it.
+    const TileGrid* _grid = nullptr;
+    std::vector<uint32_t> _binEntries;
+    std::vector<uint32_t> _binStart; // _binEntries[_binStart[t] .. _binStart[t + 1]] are in tile t
+    bool _binsDirty = true;
 
     void EmitParticle(double max);
-    void UpdateSpawnArea();
-    void LoadImages(nonstd::span<nonstd::span<const uint8_t>> images);
+    [[nodiscard]] pntr_rectangle GetParticleRect(size_t i) const noexcept;
+    [[nodiscard]] pntr_rectangle GetBounds() const noexcept;
 };
@@ -0,0 +1,133 @@
+#include "profiler.hpp"
+
+#ifdef HAVE_PROFILER
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+
+namespace {
+    // About ten seconds at 60 FPS
+    constexpr size_t PROFILE_WINDOW = 600;
+
+    constexpr std::array<const char*, PROFILE_PHASE_COUNT> PHASE_NAMES {
+        "romcleaner_run",
+        "romcleaner_update",
+        "romcleaner_render",
+        "romcleaner_particles_update",
+        "romcleaner_particles_draw",
+        "romcleaner_blow_detect",
+        "romcleaner_audio_mix",
+        "romcleaner_video_refresh",
+    };
+
+    retro_log_printf_t _log = nullptr;
+    retro_perf_callback _perf {};
+
+    // For converting ticks to microseconds, since the frontend's counter has no fixed rate
+    uint64_t _startTicks = 0;
+    std::chrono::steady_clock::time_point _startTime {};
+
+    std::array<retro_perf_counter, PROFILE_PHASE_COUNT> _counters {};
+    std::array<std::atomic<uint64_t>, PROFILE_PHASE_COUNT> _frameTicks {};
+    std::array<std::atomic<uint64_t>, PROFILE_PHASE_COUNT> _frameCalls {};
+    std::array<std::array<uint64_t, PROFILE_WINDOW>, PROFILE_PHASE_COUNT> _history {};
+    std::array<uint64_t, PROFILE_PHASE_COUNT> _lastFrame {};
+    size_t _frameCount = 0;
+
+    double GetTicksPerMicrosecond() noexcept {
+        if (!_perf.get_perf_counter)
+            return 1000.0; // std::chrono ticks are nanoseconds
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _startTime);
+        if (elapsed.count() <= 0)
+            return 1000.0;
+
+        return static_cast<double>(ProfilerNow() - _startTicks) / elapsed.count();
+    }
+}
+
+void ProfilerInit(retro_environment_t environment, retro_log_printf_t log) noexcept {
+    _log = log;
+    if (!environment(RETRO_ENVIRONMENT_GET_PERF_INTERFACE, &_perf)) {
+        _perf = {};
+    }
+
+    for (size_t i = 0; i < PROFILE_PHASE_COUNT; ++i) {
+        _counters[i] = {};
+        _counters[i].ident = PHASE_NAMES[i];
+        if (_perf.get_perf_counter && _perf.perf_register) {
+            _perf.perf_register(&_counters[i]);
+        }
+    }
+
+    _startTicks = ProfilerNow();
+    _startTime = std::chrono::steady_clock::now();
+    _frameCount = 0;
+}
+
+uint64_t ProfilerNow() noexcept {
+    if (_perf.get_perf_counter)
+        return _perf.get_perf_counter();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ProfilerAdd(ProfilePhase phase, uint64_t ticks) noexcept {
+    size_t i = static_cast<size_t>(phase);
+    _frameTicks[i].fetch_add(ticks, std::memory_order_relaxed);
+    _frameCalls[i].fetch_add(1, std::memory_order_relaxed);
+}
+
+void ProfilerEndFrame() noexcept {
+    for (size_t i = 0; i < PROFILE_PHASE_COUNT; ++i) {
+        uint64_t ticks = _frameTicks[i].exchange(0, std::memory_order_relaxed);
+        uint64_t calls = _frameCalls[i].exchange(0, std::memory_order_relaxed);
+
+        _lastFrame[i] = ticks;
+        _history[i][_frameCount % PROFILE_WINDOW] = ticks;
+
+        // Only counters measured with the frontend's clock mean anything to the frontend
+        if (_perf.get_perf_counter) {
+            _counters[i].total += ticks;
+            _counters[i].call_cnt += calls;
+        }
+    }
+
+    ++_frameCount;
+}
+
+void ProfilerReport() noexcept {
+    size_t frames = std::min(_frameCount, PROFILE_WINDOW);
+    if (!_log || frames == 0)
+        return;
+
+    double ticksPerMs = GetTicksPerMicrosecond() * 1000.0;
+    std::array<uint64_t, PROFILE_WINDOW> sorted {};
+
+    _log(RETRO_LOG_INFO, "[profiler] Frame times over the last %zu frames (%s clock):\n", frames, _perf.get_perf_counter ? "frontend" : "std::chrono");
+    for (size_t i = 0; i < PROFILE_PHASE_COUNT; ++i) {
+        std::copy_n(_history[i].begin(), frames, sorted.begin());
+        std::sort(sorted.begin(), sorted.begin() + frames);
+
+        uint64_t sum = 0;
+        for (size_t f = 0; f < frames; ++f) {
+            sum += sorted[f];
+        }
+
+        size_t p99 = std::min(frames - 1, frames * 99 / 100);
+        _log(
+            RETRO_LOG_INFO,
+            "[profiler] %-28s min %8.3f ms  avg %8.3f ms  p99 %8.3f ms\n",
+            PHASE_NAMES[i],
+            sorted[0] / ticksPerMs,
+            static_cast<double>(sum) / frames / ticksPerMs,
+            sorted[p99] / ticksPerMs
+        );
+    }
+}
+
+double ProfilerGetLastFrameMicroseconds(ProfilePhase phase) noexcept {
+    return _lastFrame[static_cast<size_t>(phase)] / GetTicksPerMicrosecond();
+}
+#endif
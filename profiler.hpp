@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <libretro.h>
+
+// The parts of a frame that the profiler times separately.
+// Phases can nest (Render includes ParticlesDraw), so their times don't add up to Run's.
+enum class ProfilePhase : size_t {
+    Run,
+    Update,
+    Render,
+    ParticlesUpdate,
+    ParticlesDraw,
+    BlowDetect,
+    AudioMix,
+    VideoRefresh,
+    Count,
+};
+
+constexpr size_t PROFILE_PHASE_COUNT = static_cast<size_t>(ProfilePhase::Count);
+
+#ifdef HAVE_PROFILER
+// Uses the frontend's perf counters if it has them, and std::chrono if it doesn't.
+// Each phase is also registered as a libretro perf counter, so the frontend can report on it too.
+void ProfilerInit(retro_environment_t environment, retro_log_printf_t log) noexcept;
+
+// The current time in profiler ticks; safe to call from any thread
+[[nodiscard]] uint64_t ProfilerNow() noexcept;
+
+// Adds time to the current frame's total for the phase; safe to call from any thread
+void ProfilerAdd(ProfilePhase phase, uint64_t ticks) noexcept;
+
+// Closes the current frame, adding its totals to the rolling window. Main thread only.
+void ProfilerEndFrame() noexcept;
+
+// Logs the min, average and 99th percentile of each phase over the rolling window
+void ProfilerReport() noexcept;
+
+// How long the phase took in the last completed frame, for drawing on screen
+[[nodiscard]] double ProfilerGetLastFrameMicroseconds(ProfilePhase phase) noexcept;
+
+// Times everything from its construction to the end of its scope
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfilePhase phase) noexcept : _phase(phase), _start(ProfilerNow()) {}
+    ~ProfileScope() noexcept { ProfilerAdd(_phase, ProfilerNow() - _start); }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+    ProfileScope(ProfileScope&&) = delete;
+    ProfileScope& operator=(ProfileScope&&) = delete;
+
+private:
+    ProfilePhase _phase;
+    uint64_t _start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(phase) ProfileScope PROFILE_CONCAT(_profileScope, __LINE__) { ProfilePhase::phase }
+#define PROFILE_END_FRAME() ProfilerEndFrame()
+#define PROFILE_REPORT() ProfilerReport()
+#else
+// Without HAVE_PROFILER, none of this compiles to anything
+#define PROFILE_SCOPE(phase) do {} while (0)
+#define PROFILE_END_FRAME() do {} while (0)
+#define PROFILE_REPORT() do {} while (0)
+#endif
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <nonstd/span.hpp>
+
+// Advances a SplitMix64 state and returns the next output.
+// Good for turning one seed into several well-mixed ones, not for bulk random numbers.
+constexpr uint64_t SplitMix64(uint64_t& state) noexcept {
+    state += 0x9E3779B97F4A7C15ull;
+    uint64_t z = state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Derives the seed of one of several independent streams (e.g. one per particle system) from a single seed.
+constexpr uint64_t DeriveSeed(uint64_t seed, uint64_t stream) noexcept {
+    uint64_t state = seed ^ (stream * 0xD1B54A32D192ED03ull);
+    return SplitMix64(state);
+}
+
+// xoshiro128** (https://prng.di.unimi.it): small, fast, and its state is plain data,
+// so it can be copied into savestates as-is.
+// It works on 32-bit words, so it's just as cheap on 32-bit targets.
+class Rng {
+public:
+    using State = std::array<uint32_t, 4>;
+
+    constexpr Rng() noexcept : Rng(0) {}
+
+    explicit constexpr Rng(uint64_t seed) noexcept {
+        uint64_t state = seed;
+        uint64_t a = SplitMix64(state);
+        uint64_t b = SplitMix64(state);
+        _state = {
+            static_cast<uint32_t>(a), static_cast<uint32_t>(a >> 32),
+            static_cast<uint32_t>(b), static_cast<uint32_t>(b >> 32),
+        };
+
+        // The all-zero state would only ever produce zeroes; SplitMix64 makes it vanishingly unlikely
+        if ((_state[0] | _state[1] | _state[2] | _state[3]) == 0) {
+            _state[0] = 1;
+        }
+    }
+
+    constexpr uint32_t Next() noexcept {
+        uint32_t result = RotateLeft(_state[1] * 5, 7) * 9;
+        uint32_t t = _state[1] << 9;
+
+        _state[2] ^= _state[0];
+        _state[3] ^= _state[1];
+        _state[1] ^= _state[2];
+        _state[0] ^= _state[3];
+        _state[2] ^= t;
+        _state[3] = RotateLeft(_state[3], 11);
+
+        return result;
+    }
+
+    // Maps a raw output onto [0, range) by multiplying and shifting, which avoids a division.
+    // The bias is at most range / 2^32, far below anything visible.
+    static constexpr uint32_t Scale(uint32_t random, uint32_t range) noexcept {
+        return static_cast<uint32_t>((static_cast<uint64_t>(random) * range) >> 32);
+    }
+
+    constexpr uint32_t NextBelow(uint32_t range) noexcept {
+        return Scale(Next(), range);
+    }
+
+    // Fills the buffer with raw outputs, for callers that need many numbers at once
+    void Fill(nonstd::span<uint32_t> output) noexcept {
+        // Work on a copy, so that stores to the output can't force the state to be reloaded
+        State state = _state;
+        for (uint32_t& value : output) {
+            value = RotateLeft(state[1] * 5, 7) * 9;
+            uint32_t t = state[1] << 9;
+
+            state[2] ^= state[0];
+            state[3] ^= state[1];
+            state[1] ^= state[2];
+            state[0] ^= state[3];
+            state[2] ^= t;
+            state[3] = RotateLeft(state[3], 11);
+        }
+        _state = state;
+    }
+
+    [[nodiscard]] constexpr const State& GetState() const noexcept { return _state; }
+
+    // Returns false (and changes nothing) for the all-zero state, which isn't valid
+    constexpr bool SetState(const State& state) noexcept {
+        if ((state[0] | state[1] | state[2] | state[3]) == 0)
+            return false;
+
+        _state = state;
+        return true;
+    }
+
+private:
+    State _state {};
+
+    static constexpr uint32_t RotateLeft(uint32_t x, int k) noexcept {
+        return (x << k) | (x >> (32 - k));
+    }
+};
@@ -0,0 +1,193 @@
+#include "rom_cache.hpp"
+
+#include <cstdlib>
+#include <vector>
+
+#include <streams/file_stream.h>
+#include <string/stdstring.h>
+
+#include "checksum.hpp"
+#include "serialize.hpp"
+
+namespace {
+    // "RCCA" and "RREC" when read as little-endian bytes
+    constexpr uint32_t CACHE_MAGIC = 0x41434352;
+    constexpr uint32_t RECORD_MAGIC = 0x43455252;
+
+    // Written in native byte order, like the records; a cache from a machine with the other byte order is discarded
+    constexpr uint32_t CACHE_BYTE_ORDER = 0x01020304;
+
+    constexpr size_t CACHE_HEADER_SIZE = 3 * sizeof(uint32_t); // Magic, version, byte order
+    constexpr size_t RECORD_HEADER_SIZE = 3 * sizeof(uint32_t); // Magic, payload size, payload CRC-32
+
+    // Far more than any record with a real path needs; a bigger size means the log is damaged
+    constexpr uint32_t MAX_RECORD_SIZE = 64 * 1024;
+
+    // Superseded records are only cleared out once there are more of them than live ones, and enough to be worth it
+    constexpr size_t MIN_RECORDS_BEFORE_COMPACTING = 64;
+
+    void WritePayload(StateWriter& writer, const std::string& romPath, const FileStamp& stamp, const RomHashes& hashes) noexcept {
+        writer.Write(stamp.size);
+        writer.Write(stamp.modified);
+        writer.Write(stamp.inode);
+        writer.Write(hashes.format);
+        writer.Write(hashes.size);
+        writer.Write(hashes.crc32);
+        writer.WriteArray(nonstd::span<const uint8_t>(hashes.md5));
+        writer.WriteArray(nonstd::span<const uint8_t>(hashes.sha1));
+        writer.WriteSize(romPath.size());
+        writer.WriteArray(nonstd::span<const char>(romPath.data(), romPath.size()));
+    }
+
+    bool ReadPayload(nonstd::span<const uint8_t> payload, std::string& romPath, FileStamp& stamp, RomHashes& hashes) {
+        StateReader reader(payload);
+        reader.Read(stamp.size);
+        reader.Read(stamp.modified);
+        reader.Read(stamp.inode);
+        reader.Read(hashes.format);
+        reader.Read(hashes.size);
+        reader.Read(hashes.crc32);
+        reader.ReadArray(nonstd::span<uint8_t>(hashes.md5));
+        reader.ReadArray(nonstd::span<uint8_t>(hashes.sha1));
+
+        size_t pathLength = 0;
+        if (!reader.ReadSize(pathLength) || pathLength > payload.size() - reader.GetPosition() || hashes.format > RomFormat::INes)
+            return false;
+
+        romPath.assign(reinterpret_cast<const char*>(payload.data() + reader.GetPosition()), pathLength);
+        return reader.IsOk() && reader.GetPosition() + pathLength == payload.size();
+    }
+
+    void AppendHeader(std::vector<uint8_t>& log) {
+        size_t start = log.size();
+        log.resize(start + CACHE_HEADER_SIZE);
+        StateWriter writer({ log.data() + start, CACHE_HEADER_SIZE });
+        writer.Write(CACHE_MAGIC);
+        writer.Write(ROM_CACHE_VERSION);
+        writer.Write(CACHE_BYTE_ORDER);
+    }
+
+    void AppendRecord(std::vector<uint8_t>& log, const std::string& romPath, const FileStamp& stamp, const RomHashes& hashes) {
+        StateWriter counter;
+        WritePayload(counter, romPath, stamp, hashes);
+        size_t payloadSize = counter.GetSize();
+
+        size_t start = log.size();
+        log.resize(start + RECORD_HEADER_SIZE + payloadSize);
+        nonstd::span<uint8_t> payload(log.data() + start + RECORD_HEADER_SIZE, payloadSize);
+        StateWriter writer(payload);
+        WritePayload(writer, romPath, stamp, hashes);
+
+        StateWriter header({ log.data() + start, RECORD_HEADER_SIZE });
+        header.Write(RECORD_MAGIC);
+        header.Write(static_cast<uint32_t>(payloadSize));
+        header.Write(Crc32Update(0, payload));
+    }
+}
+
+bool RomCache::Open(const char* path) {
+    Close();
+    if (string_is_empty(path))
+        return false;
+
+    _path = path;
+
+    void* data = nullptr;
+    int64_t length = 0;
+    bool usable = false;
+    size_t records = 0;
+    size_t position = 0;
+    if (filestream_read_file(path, &data, &length) && data) {
+        nonstd::span<const uint8_t> log(static_cast<const uint8_t*>(data), static_cast<size_t>(length));
+        StateReader header(log);
+        uint32_t magic = 0, version = 0, byteOrder = 0;
+        header.Read(magic);
+        header.Read(version);
+        header.Read(byteOrder);
+        usable = header.IsOk() && magic == CACHE_MAGIC && version == ROM_CACHE_VERSION && byteOrder == CACHE_BYTE_ORDER;
+
+        position = CACHE_HEADER_SIZE;
+        while (usable && position < log.size()) {
+            StateReader reader(log.subspan(position));
+            uint32_t recordMagic = 0, payloadSize = 0, crc = 0;
+            reader.Read(recordMagic);
+            reader.Read(payloadSize);
+            reader.Read(crc);
+            if (!reader.IsOk() || recordMagic != RECORD_MAGIC || payloadSize > MAX_RECORD_SIZE ||
+                payloadSize > log.size() - position - RECORD_HEADER_SIZE)
+                break;
+
+            nonstd::span<const uint8_t> payload = log.subspan(position + RECORD_HEADER_SIZE, payloadSize);
+            std::string romPath;
+            Entry entry {};
+            if (Crc32Update(0, payload) != crc || !ReadPayload(payload, romPath, entry.stamp, entry.hashes))
+                break;
+
+            _entries[std::move(romPath)] = entry;
+            ++records;
+            position += RECORD_HEADER_SIZE + payloadSize;
+        }
+        free(data);
+    }
+
+    // A log that's missing, from another version, damaged or mostly superseded records is written out afresh
+    bool damaged = usable && position != static_cast<size_t>(length);
+    bool bloated = records >= MIN_RECORDS_BEFORE_COMPACTING && records > 2 * _entries.size();
+    if ((!usable || damaged || bloated) && !Rewrite()) {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void RomCache::Close() noexcept {
+    _path.clear();
+    _entries.clear();
+}
+
+// Writes a new log with just the live entries.
+// Not atomic, but a log that's cut short loses nothing but the records after the cut.
+bool RomCache::Rewrite() {
+    std::vector<uint8_t> log;
+    AppendHeader(log);
+    for (const auto& [romPath, entry] : _entries) {
+        AppendRecord(log, romPath, entry.stamp, entry.hashes);
+    }
+
+    return filestream_write_file(_path.c_str(), log.data(), static_cast<int64_t>(log.size()));
+}
+
+bool RomCache::Find(const std::string& romPath, const FileStamp& stamp, RomHashes& hashes) const noexcept {
+    auto entry = _entries.find(romPath);
+    if (entry == _entries.end() || entry->second.stamp != stamp)
+        return false;
+
+    hashes = entry->second.hashes;
+    return true;
+}
+
+bool RomCache::Store(const std::string& romPath, const FileStamp& stamp, const RomHashes& hashes) {
+    if (!IsOpen())
+        return false;
+
+    std::vector<uint8_t> record;
+    AppendRecord(record, romPath, stamp, hashes);
+
+    RFILE* file = filestream_open(
+        _path.c_str(),
+        RETRO_VFS_FILE_ACCESS_WRITE | RETRO_VFS_FILE_ACCESS_UPDATE_EXISTING,
+        RETRO_VFS_FILE_ACCESS_HINT_NONE
+    );
+    if (!file)
+        return false;
+
+    auto size = static_cast<int64_t>(record.size());
+    bool written = filestream_seek(file, 0, RETRO_VFS_SEEK_POSITION_END) >= 0 && filestream_write(file, record.data(), size) == size;
+    filestream_close(file);
+
+    if (written) {
+        _entries[romPath] = { stamp, hashes };
+    }
+    return written;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "rom_file.hpp"
+#include "rom_hasher.hpp"
+
+// Bump whenever the record layout changes, or whenever the same ROM would hash differently (e.g. new normalizations);
+// caches from other versions are discarded
+constexpr uint32_t ROM_CACHE_VERSION = 1;
+
+// Remembers each ROM's hashes between sessions, so a ROM that hasn't changed since it was last loaded isn't read again.
+// The cache is an append-only log of records, each keyed by the ROM's path and stamped with its size,
+// modification time and inode; a ROM whose stamp no longer matches is simply hashed again.
+// Every record carries a CRC-32, so one that was only partly written (if the frontend was killed, say)
+// is dropped along with everything after it.
+// The log is indexed in memory when it's opened, and later records for a path replace earlier ones.
+class RomCache {
+public:
+    RomCache() noexcept = default;
+    ~RomCache() noexcept = default;
+    RomCache(const RomCache&) = delete;
+    RomCache& operator=(const RomCache&) = delete;
+    RomCache(RomCache&&) = delete;
+    RomCache& operator=(RomCache&&) = delete;
+
+    // Reads and indexes the log at path, starting a new one if it doesn't exist or can't be used.
+    // Rewrites the log without its superseded and damaged records if they've piled up.
+    bool Open(const char* path);
+    void Close() noexcept;
+
+    [[nodiscard]] bool IsOpen() const noexcept { return !_path.empty(); }
+    [[nodiscard]] size_t GetEntryCount() const noexcept { return _entries.size(); }
+
+    // Returns false if the ROM isn't in the cache, or has changed since it was
+    [[nodiscard]] bool Find(const std::string& romPath, const FileStamp& stamp, RomHashes& hashes) const noexcept;
+
+    // Appends the ROM's hashes to the log
+    bool Store(const std::string& romPath, const FileStamp& stamp, const RomHashes& hashes);
+
+private:
+    struct Entry {
+        FileStamp stamp;
+        RomHashes hashes;
+    };
+
+    std::string _path;
+    std::unordered_map<std::string, Entry> _entries;
+
+    bool Rewrite();
+};
@@ -0,0 +1,373 @@
+#include "rom_file.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <file/file_path.h>
+#include <streams/file_stream.h>
+#include <string/stdstring.h>
+
+#ifdef HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool GetFileStamp(const char* path, FileStamp& stamp) noexcept {
+    struct stat info {};
+    if (!path || stat(path, &info) != 0)
+        return false;
+
+    stamp.size = static_cast<uint64_t>(info.st_size);
+    stamp.modified = static_cast<int64_t>(info.st_mtime);
+    stamp.inode = static_cast<uint64_t>(info.st_ino);
+    return true;
+}
+
+namespace {
+    // How much compressed data is read at a time from an archive that isn't mapped
+    constexpr size_t ZIP_INPUT_BUFFER_SIZE = 64 * 1024;
+
+    // A zip's central directory is a few dozen bytes per entry; anything much bigger than this isn't a ROM set
+    constexpr uint64_t MAX_ZIP_DIRECTORY_SIZE = 16 * 1024 * 1024;
+
+    // Finds the '#' in "archive.zip#entry"
+    size_t FindZipEntrySeparator(const std::string& path) noexcept {
+        constexpr char EXTENSION[] = ".zip";
+        constexpr size_t EXTENSION_LENGTH = sizeof(EXTENSION) - 1;
+        for (size_t i = path.find('#'); i != std::string::npos; i = path.find('#', i + 1)) {
+            if (i < EXTENSION_LENGTH)
+                continue;
+
+            bool matches = true;
+            for (size_t j = 0; j < EXTENSION_LENGTH; ++j) {
+                matches &= std::tolower(static_cast<unsigned char>(path[i - EXTENSION_LENGTH + j])) == EXTENSION[j];
+            }
+            if (matches)
+                return i;
+        }
+        return std::string::npos;
+    }
+}
+
+bool GetRomStamp(const char* path, FileStamp& stamp) {
+    if (GetFileStamp(path, stamp))
+        return true;
+
+    std::string filePath = path ? path : "";
+    size_t separator = FindZipEntrySeparator(filePath);
+    if (separator == std::string::npos)
+        return false;
+
+    filePath.resize(separator);
+    return GetFileStamp(filePath.c_str(), stamp);
+}
+
+RomFile::~RomFile() noexcept {
+    Close();
+}
+
+bool RomFile::IsInflated() const noexcept {
+#ifdef HAVE_ZLIB
+    return _inflater != nullptr;
+#else
+    return false;
+#endif
+}
+
+bool RomFile::Open(const char* path, Access access) {
+    Close();
+    if (string_is_empty(path))
+        return false;
+
+    // A path that names an archive's entry doesn't exist as it's written
+    std::string filePath = path;
+    std::string entryName;
+    FileStamp stamp {};
+    if (!GetFileStamp(path, stamp)) {
+        size_t separator = FindZipEntrySeparator(filePath);
+        if (separator != std::string::npos) {
+            entryName = filePath.substr(separator + 1);
+            filePath.resize(separator);
+        }
+    }
+
+    if (!OpenFile(filePath.c_str(), access))
+        return false;
+
+    _name = path;
+    if (entryName.empty() && !string_is_equal_noncase(path_get_extension(filePath.c_str()), "zip"))
+        return true;
+
+    if (!OpenZipEntry(entryName.c_str())) {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+bool RomFile::OpenFile(const char* path, Access access) noexcept {
+#ifdef HAVE_MMAP
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        struct stat info {};
+        // Empty files can't be mapped, and files bigger than the address space (on 32-bit hosts) don't fit
+        if (fstat(fd, &info) == 0 && info.st_size > 0 && static_cast<uint64_t>(info.st_size) <= SIZE_MAX) {
+            void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                // A file that's read once, front to back, lets the kernel read ahead aggressively;
+                // one that's jumped around in would only waste the read-ahead
+                madvise(mapping, static_cast<size_t>(info.st_size), access == Access::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+                _mapping = static_cast<const uint8_t*>(mapping);
+                _fileSize = static_cast<uint64_t>(info.st_size);
+                _size = _fileSize;
+            }
+        }
+        close(fd); // The mapping keeps the file open
+    }
+
+    if (_mapping)
+        return true;
+#else
+    static_cast<void>(access); // Streams are read however they're read
+#endif
+
+    _stream = filestream_open(path, RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE);
+    if (!_stream)
+        return false;
+
+    int64_t size = filestream_get_size(_stream);
+    if (size < 0) {
+        Close();
+        return false;
+    }
+
+    _fileSize = static_cast<uint64_t>(size);
+    _size = _fileSize;
+    return true;
+}
+
+bool RomFile::OpenZipEntry(const char* entryName) {
+    std::vector<uint8_t> scratch(static_cast<size_t>(std::min<uint64_t>(_fileSize, ZIP_DIRECTORY_SEARCH_SIZE)));
+    uint64_t tailOffset = _fileSize - scratch.size();
+    ZipDirectoryLocation location {};
+    if (!ReadAt(tailOffset, scratch) || !FindZipDirectory(scratch, tailOffset, location))
+        return false;
+
+    if (location.zip64RecordOffset != UINT64_MAX) {
+        scratch.resize(ZIP64_DIRECTORY_RECORD_SIZE);
+        if (!ReadAt(location.zip64RecordOffset, scratch) || !ReadZip64DirectoryRecord(scratch, location))
+            return false;
+    }
+
+    if (location.size > MAX_ZIP_DIRECTORY_SIZE)
+        return false;
+
+    std::vector<ZipEntry> entries;
+    scratch.resize(static_cast<size_t>(location.size));
+    if (!ReadAt(location.offset, scratch) || !ReadZipDirectory(scratch, entries))
+        return false;
+
+    const ZipEntry* entry = SelectZipEntry(entries, entryName);
+    if (!entry)
+        return false;
+
+    uint64_t dataOffset = 0;
+    scratch.resize(ZIP_LOCAL_HEADER_SIZE);
+    if (!ReadAt(entry->localHeaderOffset, scratch) || !GetZipDataOffset(scratch, *entry, dataOffset))
+        return false;
+
+    if (dataOffset > _fileSize || entry->compressedSize > _fileSize - dataOffset)
+        return false;
+
+    switch (entry->method) {
+        case ZIP_METHOD_STORED:
+            if (entry->compressedSize != entry->size)
+                return false;
+            break;
+#ifdef HAVE_ZLIB
+        case ZIP_METHOD_DEFLATED:
+            _inflater = std::make_unique<ZipInflater>();
+            if (!_inflater->IsValid())
+                return false;
+
+            _compressedSize = entry->compressedSize;
+            _compressedRead = 0;
+            _input = {};
+            if (!_mapping) {
+                _inputBuffer.resize(ZIP_INPUT_BUFFER_SIZE);
+            }
+            break;
+#endif
+        default:
+            return false;
+    }
+
+    if (_stream && filestream_seek(_stream, static_cast<int64_t>(dataOffset), RETRO_VFS_SEEK_POSITION_START) < 0)
+        return false;
+
+    _name = entry->name;
+    _archived = true;
+    _dataOffset = dataOffset;
+    _size = entry->size;
+    _position = 0;
+    return true;
+}
+
+void RomFile::Close() noexcept {
+#ifdef HAVE_MMAP
+    if (_mapping) {
+        munmap(const_cast<uint8_t*>(_mapping), static_cast<size_t>(_fileSize));
+    }
+#endif
+    _mapping = nullptr;
+
+    if (_stream) {
+        filestream_close(_stream);
+        _stream = nullptr;
+    }
+
+#ifdef HAVE_ZLIB
+    _inflater.reset();
+    _compressedSize = 0;
+    _compressedRead = 0;
+    _input = {};
+    _inputBuffer = {};
+#endif
+
+    _name.clear();
+    _archived = false;
+    _fileSize = 0;
+    _dataOffset = 0;
+    _size = 0;
+    _position = 0;
+}
+
+// Reads exactly out.size() bytes from anywhere in the file; only used while opening an archive's entry
+bool RomFile::ReadAt(uint64_t offset, nonstd::span<uint8_t> out) noexcept {
+    if (offset > _fileSize || out.size() > _fileSize - offset)
+        return false;
+
+    if (_mapping) {
+        memcpy(out.data(), _mapping + offset, out.size());
+        return true;
+    }
+
+    if (!_stream || filestream_seek(_stream, static_cast<int64_t>(offset), RETRO_VFS_SEEK_POSITION_START) < 0)
+        return false;
+
+    size_t read = 0;
+    while (read < out.size()) {
+        int64_t bytes = filestream_read(_stream, out.data() + read, static_cast<int64_t>(out.size() - read));
+        if (bytes <= 0)
+            return false;
+        read += static_cast<size_t>(bytes);
+    }
+    return true;
+}
+
+nonstd::span<const uint8_t> RomFile::Read(size_t length, uint8_t* buffer) noexcept {
+    length = static_cast<size_t>(std::min<uint64_t>(length, _size - _position));
+    if (length == 0)
+        return {};
+
+#ifdef HAVE_ZLIB
+    if (_inflater)
+        return ReadInflated(length, buffer);
+#endif
+
+    if (_mapping) {
+        nonstd::span<const uint8_t> view(_mapping + _dataOffset + _position, length);
+        _position += length;
+        return view;
+    }
+
+    if (!_stream || !buffer)
+        return {};
+
+    int64_t read = filestream_read(_stream, buffer, static_cast<int64_t>(length));
+    if (read <= 0)
+        return {};
+
+    _position += static_cast<uint64_t>(read);
+    return { buffer, static_cast<size_t>(read) };
+}
+
+#ifdef HAVE_ZLIB
+nonstd::span<const uint8_t> RomFile::ReadInflated(size_t length, uint8_t* buffer) noexcept {
+    if (!buffer)
+        return {};
+
+    size_t inflated = 0;
+    while (inflated < length && !_inflater->IsFinished() && !_inflater->HasFailed()) {
+        if (_input.empty() && !RefillInput())
+            break;
+
+        inflated += _inflater->Inflate(_input, { buffer + inflated, length - inflated });
+    }
+
+    _position += inflated;
+    return inflated > 0 ? nonstd::span<const uint8_t>(buffer, inflated) : nonstd::span<const uint8_t>();
+}
+
+// Gives the inflater more compressed data: the rest of it at once from a mapping, otherwise a buffer's worth
+bool RomFile::RefillInput() noexcept {
+    uint64_t remaining = _compressedSize - _compressedRead;
+    if (remaining == 0)
+        return false;
+
+    if (_mapping) {
+        _input = { _mapping + _dataOffset + _compressedRead, static_cast<size_t>(remaining) };
+    } else {
+        size_t length = static_cast<size_t>(std::min<uint64_t>(remaining, _inputBuffer.size()));
+        int64_t read = filestream_read(_stream, _inputBuffer.data(), static_cast<int64_t>(length));
+        if (read <= 0)
+            return false;
+
+        _input = { _inputBuffer.data(), static_cast<size_t>(read) };
+    }
+
+    _compressedRead += _input.size();
+    return true;
+}
+#endif
+
+bool RomFile::Seek(uint64_t position) noexcept {
+    if (position > _size || !IsOpen())
+        return false;
+
+#ifdef HAVE_ZLIB
+    if (_inflater) {
+        // A deflate stream can only be read forward, so going back means starting over
+        if (position < _position) {
+            _inflater->Reset();
+            _compressedRead = 0;
+            _input = {};
+            _position = 0;
+            if (_stream && filestream_seek(_stream, static_cast<int64_t>(_dataOffset), RETRO_VFS_SEEK_POSITION_START) < 0)
+                return false;
+        }
+
+        // Only ever used to skip headers, so a small buffer is enough
+        std::array<uint8_t, 4096> skipped {};
+        while (_position < position) {
+            size_t length = static_cast<size_t>(std::min<uint64_t>(position - _position, skipped.size()));
+            if (ReadInflated(length, skipped.data()).empty())
+                return false;
+        }
+        return true;
+    }
+#endif
+
+    if (_stream && filestream_seek(_stream, static_cast<int64_t>(_dataOffset + position), RETRO_VFS_SEEK_POSITION_START) < 0)
+        return false;
+
+    _position = position;
+    return true;
+}
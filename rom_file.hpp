@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nonstd/span.hpp>
+
+#include "zip_archive.hpp"
+
+struct RFILE;
+
+// Enough of a file's metadata to tell whether it's changed since it was last seen
+struct FileStamp {
+    uint64_t size = 0;
+    int64_t modified = 0; // Seconds since the epoch
+    uint64_t inode = 0;   // Zero where the filesystem doesn't have them
+
+    [[nodiscard]] bool operator==(const FileStamp& other) const noexcept {
+        return size == other.size && modified == other.modified && inode == other.inode;
+    }
+    [[nodiscard]] bool operator!=(const FileStamp& other) const noexcept { return !(*this == other); }
+};
+
+[[nodiscard]] bool GetFileStamp(const char* path, FileStamp& stamp) noexcept;
+
+// Like GetFileStamp, but takes any path RomFile can open; an archive entry's stamp is its archive's
+[[nodiscard]] bool GetRomStamp(const char* path, FileStamp& stamp);
+
+// A ROM (or any other file we only read) opened for one front-to-back pass.
+// It's memory-mapped where the platform allows, so reading it copies nothing;
+// otherwise it's read in blocks through libretro's file streams.
+// A .zip (or "archive.zip#entry", as frontends name entries) opens one of the archive's entries instead.
+// Stored entries of a mapped archive are still read in place; deflated ones are inflated into the caller's buffer.
+class RomFile {
+public:
+    RomFile() noexcept = default;
+    ~RomFile() noexcept;
+    RomFile(const RomFile&) = delete;
+    RomFile& operator=(const RomFile&) = delete;
+    RomFile(RomFile&&) = delete;
+    RomFile& operator=(RomFile&&) = delete;
+
+    enum class Access {
+        Sequential, // One pass, front to back
+        Random,     // Jumping around a mapping, e.g. to binary search it
+    };
+
+    bool Open(const char* path, Access access = Access::Sequential);
+    void Close() noexcept;
+
+    [[nodiscard]] bool IsOpen() const noexcept { return _mapping || _stream; }
+    [[nodiscard]] bool IsMapped() const noexcept { return _mapping && !IsInflated(); }
+    [[nodiscard]] bool IsArchived() const noexcept { return _archived; }
+    [[nodiscard]] uint64_t GetSize() const noexcept { return _size; }
+
+    // The entry's name for an archive, otherwise the path; either way its extension says what kind of file it is
+    [[nodiscard]] const char* GetName() const noexcept { return _name.c_str(); }
+
+    // The whole file (or archive entry), if it's mapped; empty otherwise
+    [[nodiscard]] nonstd::span<const uint8_t> GetMapping() const noexcept {
+        return IsMapped() ? nonstd::span<const uint8_t>(_mapping + _dataOffset, static_cast<size_t>(_size)) : nonstd::span<const uint8_t>();
+    }
+
+    // Returns the next `length` bytes of the file, or fewer at the end; none at all on error.
+    // A mapped file returns a view of the mapping and ignores buffer (which may be null),
+    // otherwise the bytes are read into buffer, which must have room for all of them.
+    [[nodiscard]] nonstd::span<const uint8_t> Read(size_t length, uint8_t* buffer) noexcept;
+
+    // Moves to `position` bytes from the start, e.g. to skip a header once it's been identified
+    bool Seek(uint64_t position) noexcept;
+
+private:
+    const uint8_t* _mapping = nullptr;
+    RFILE* _stream = nullptr;
+    std::string _name;
+    uint64_t _fileSize = 0;
+    uint64_t _dataOffset = 0; // Where in the file the data starts; only nonzero for archive entries
+    uint64_t _size = 0;
+    uint64_t _position = 0;
+    bool _archived = false;
+
+#ifdef HAVE_ZLIB
+    std::unique_ptr<ZipInflater> _inflater;
+    uint64_t _compressedSize = 0;
+    uint64_t _compressedRead = 0; // How much of the compressed data has been handed to the inflater
+    nonstd::span<const uint8_t> _input {}; // Compressed data the inflater hasn't consumed yet
+    std::vector<uint8_t> _inputBuffer; // Only used if the archive isn't mapped
+#endif
+
+    [[nodiscard]] bool IsInflated() const noexcept;
+    bool OpenFile(const char* path, Access access) noexcept;
+    bool OpenZipEntry(const char* entryName);
+    bool ReadAt(uint64_t offset, nonstd::span<uint8_t> out) noexcept;
+#ifdef HAVE_ZLIB
+    [[nodiscard]] nonstd::span<const uint8_t> ReadInflated(size_t length, uint8_t* buffer) noexcept;
+    bool RefillInput() noexcept;
+#endif
+};
@@ -0,0 +1,149 @@
+#include "rom_format.hpp"
+
+#include <cstring>
+
+#include <string/stdstring.h>
+
+#if defined(__SSSE3__)
+#define ROMCLEANER_FORMAT_SSSE3
+#include <tmmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ROMCLEANER_FORMAT_SSE2
+#include <emmintrin.h>
+#elif defined(HAVE_NEON)
+#define ROMCLEANER_FORMAT_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+    constexpr uint8_t N64_BIG_ENDIAN_MAGIC[] = { 0x80, 0x37, 0x12, 0x40 };
+    constexpr uint8_t N64_BYTE_SWAPPED_MAGIC[] = { 0x37, 0x80, 0x40, 0x12 };
+    constexpr uint8_t N64_LITTLE_ENDIAN_MAGIC[] = { 0x40, 0x12, 0x37, 0x80 };
+    constexpr uint8_t INES_MAGIC[] = { 'N', 'E', 'S', 0x1a };
+
+    constexpr size_t INES_HEADER_SIZE = 16;
+    constexpr size_t SNES_COPIER_HEADER_SIZE = 512;
+
+    template<size_t N>
+    bool HasMagic(nonstd::span<const uint8_t> head, const uint8_t (&magic)[N]) noexcept {
+        return head.size() >= N && memcmp(head.data(), magic, N) == 0;
+    }
+
+    bool IsSnesExtension(const char* extension) noexcept {
+        return extension && (
+            string_is_equal_noncase(extension, "smc") ||
+            string_is_equal_noncase(extension, "swc") ||
+            string_is_equal_noncase(extension, "sfc") ||
+            string_is_equal_noncase(extension, "fig")
+        );
+    }
+}
+
+RomLayout DetectRomLayout(nonstd::span<const uint8_t> head, uint64_t size, const char* extension) noexcept {
+    if (HasMagic(head, N64_BIG_ENDIAN_MAGIC))
+        return { RomFormat::N64BigEndian, 0, 0 };
+
+    if (HasMagic(head, N64_BYTE_SWAPPED_MAGIC))
+        return { RomFormat::N64ByteSwapped, 0, 2 };
+
+    if (HasMagic(head, N64_LITTLE_ENDIAN_MAGIC))
+        return { RomFormat::N64LittleEndian, 0, 4 };
+
+    if (HasMagic(head, INES_MAGIC) && size >= INES_HEADER_SIZE)
+        return { RomFormat::INes, INES_HEADER_SIZE, 0 };
+
+    if (IsSnesExtension(extension) && size % 1024 == SNES_COPIER_HEADER_SIZE)
+        return { RomFormat::SnesCopierHeader, SNES_COPIER_HEADER_SIZE, 0 };
+
+    return {};
+}
+
+const char* GetRomFormatName(RomFormat format) noexcept {
+    switch (format) {
+        case RomFormat::N64BigEndian: return "big-endian N64 (.z64)";
+        case RomFormat::N64ByteSwapped: return "byte-swapped N64 (.v64)";
+        case RomFormat::N64LittleEndian: return "little-endian N64 (.n64)";
+        case RomFormat::SnesCopierHeader: return "copier-headered SNES";
+        case RomFormat::INes: return "iNES";
+        default: return "raw";
+    }
+}
+
+void ByteSwap(nonstd::span<const uint8_t> in, uint8_t* out, unsigned width) noexcept {
+    const uint8_t* src = in.data();
+    const size_t size = in.size();
+    size_t i = 0;
+
+    if (width != 2 && width != 4) {
+        if (out != src)
+            memmove(out, src, size);
+        return;
+    }
+
+    // Four vectors at a time, each loaded before any are stored, so swapping in place is safe
+#if defined(ROMCLEANER_FORMAT_SSSE3)
+    const __m128i shuffle = (width == 2)
+        ? _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)
+        : _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    for (; i + 64 <= size; i += 64) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 32));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 48));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_shuffle_epi8(a, shuffle));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 16), _mm_shuffle_epi8(b, shuffle));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 32), _mm_shuffle_epi8(c, shuffle));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 48), _mm_shuffle_epi8(d, shuffle));
+    }
+#elif defined(ROMCLEANER_FORMAT_SSE2)
+    // Without a byte shuffle, a 32-bit swap is a swap of each word's 16-bit halves followed by a 16-bit swap
+    auto swap = [width](__m128i v) noexcept {
+        if (width == 4) {
+            v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    };
+    for (; i + 64 <= size; i += 64) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 32));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 48));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), swap(a));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 16), swap(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 32), swap(c));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 48), swap(d));
+    }
+#elif defined(ROMCLEANER_FORMAT_NEON)
+    auto swap = [width](uint8x16_t v) noexcept {
+        return (width == 2) ? vrev16q_u8(v) : vrev32q_u8(v);
+    };
+    for (; i + 64 <= size; i += 64) {
+        uint8x16_t a = vld1q_u8(src + i);
+        uint8x16_t b = vld1q_u8(src + i + 16);
+        uint8x16_t c = vld1q_u8(src + i + 32);
+        uint8x16_t d = vld1q_u8(src + i + 48);
+        vst1q_u8(out + i, swap(a));
+        vst1q_u8(out + i + 16, swap(b));
+        vst1q_u8(out + i + 32, swap(c));
+        vst1q_u8(out + i + 48, swap(d));
+    }
+#endif
+
+    for (; i + width <= size; i += width) {
+        if (width == 2) {
+            uint8_t a = src[i], b = src[i + 1];
+            out[i] = b;
+            out[i + 1] = a;
+        } else {
+            uint8_t a = src[i], b = src[i + 1], c = src[i + 2], d = src[i + 3];
+            out[i] = d;
+            out[i + 1] = c;
+            out[i + 2] = b;
+            out[i + 3] = a;
+        }
+    }
+
+    if (i < size && out != src) {
+        memmove(out + i, src + i, size - i);
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <nonstd/span.hpp>
+
+// How a ROM file's bytes differ from the canonical image that DATs (and everyone else's checksums) describe
+enum class RomFormat : uint8_t {
+    Raw,             // Already canonical
+    N64BigEndian,    // .z64, the canonical byte order
+    N64ByteSwapped,  // .v64, every 16-bit word swapped
+    N64LittleEndian, // .n64, every 32-bit word reversed
+    SnesCopierHeader,// .smc/.swc with a 512-byte header from a copier device
+    INes,            // .nes with a 16-byte iNES header
+};
+
+struct RomLayout {
+    RomFormat format = RomFormat::Raw;
+    size_t headerSize = 0; // Skipped before the canonical image starts
+    unsigned swapWidth = 0; // Each group of this many bytes is reversed; 0 (or 1) if they're left alone
+};
+
+// Enough of the start of a ROM for DetectRomLayout to recognize it by
+constexpr size_t ROM_MAGIC_SIZE = 16;
+
+// Recognizes the formats that need normalizing by their magic bytes.
+// Copier headers have no magic, so they're only looked for in SNES ROMs (going by extension, which may be null)
+// whose size is 512 bytes past a multiple of 1 KB.
+[[nodiscard]] RomLayout DetectRomLayout(nonstd::span<const uint8_t> head, uint64_t size, const char* extension) noexcept;
+
+[[nodiscard]] const char* GetRomFormatName(RomFormat format) noexcept;
+
+// Reverses each group of `width` (2 or 4) bytes of in, writing the result to out (which may be in.data() itself,
+// but mustn't otherwise overlap it). A partial group at the end is copied as it is.
+void ByteSwap(nonstd::span<const uint8_t> in, uint8_t* out, unsigned width) noexcept;
@@ -0,0 +1,176 @@
+#include "rom_hasher.hpp"
+
+#include <algorithm>
+#include <array>
+
+#include <file/file_path.h>
+
+// MD5, SHA-1 and reading the next block each take a thread of their own
+constexpr size_t SERIAL_TASKS = 3;
+
+RomHasher::~RomHasher() noexcept {
+    Stop();
+}
+
+void RomHasher::Stop() noexcept {
+#ifdef HAVE_THREADS
+    if (_thread) {
+        _stopping.store(true, std::memory_order_relaxed);
+        sthread_join(_thread);
+        _thread = nullptr;
+        _stopping.store(false, std::memory_order_relaxed);
+    }
+#endif
+}
+
+bool RomHasher::Open(const char* path, size_t threads, size_t blockSize) {
+    Stop();
+
+    _status.store(Status::Idle, std::memory_order_relaxed);
+    _bytesHashed.store(0, std::memory_order_relaxed);
+    _hashes = {};
+    _md5.Reset();
+    _sha1.Reset();
+    _block = {};
+    _primed = false;
+    _currentBuffer = 0;
+    // Byte-swapped words mustn't straddle two blocks
+    _blockSize = std::max<size_t>(blockSize & ~size_t(3), 4);
+
+    if (!_file.Open(path))
+        return false;
+
+    // Only the start of the file is needed to tell what it is; hashing starts over at the canonical image
+    std::array<uint8_t, ROM_MAGIC_SIZE> head {};
+    _layout = DetectRomLayout(_file.Read(head.size(), head.data()), _file.GetSize(), path_get_extension(_file.GetName()));
+    if (!_file.Seek(_layout.headerSize)) {
+        _file.Close();
+        return false;
+    }
+
+    _hashes.format = _layout.format;
+    _hashes.size = _file.GetSize() - _layout.headerSize;
+
+    threads = std::max<size_t>(threads, 1);
+    if (!_pool || _pool->GetThreadCount() != threads) {
+        _pool.reset();
+        _pool = std::make_unique<WorkerPool>(threads);
+    }
+
+    // CRC-32 gets the threads that aren't busy with anything else, but it always gets at least one piece
+    _pieceCrcs.assign(std::max<size_t>(_pool->GetThreadCount(), SERIAL_TASKS + 1) - SERIAL_TASKS, 0);
+
+    for (std::vector<uint8_t>& buffer : _buffers) {
+        if (_file.IsMapped() && _layout.swapWidth < 2) {
+            buffer = {};
+        } else {
+            buffer.resize(_blockSize);
+        }
+    }
+
+    _status.store(Status::Hashing, std::memory_order_release);
+    return true;
+}
+
+void RomHasher::Restore(const RomHashes& hashes) noexcept {
+    Stop();
+    _file.Close();
+    _block = {};
+    _hashes = hashes;
+    _bytesHashed.store(hashes.size, std::memory_order_relaxed);
+    _status.store(Status::Done, std::memory_order_release);
+}
+
+bool RomHasher::Start() noexcept {
+#ifdef HAVE_THREADS
+    if (GetStatus() != Status::Hashing || _thread)
+        return false;
+
+    _thread = sthread_create(ThreadMain, this);
+    return _thread != nullptr;
+#else
+    return false;
+#endif
+}
+
+#ifdef HAVE_THREADS
+void RomHasher::ThreadMain(void* hasher) {
+    auto* self = static_cast<RomHasher*>(hasher);
+    while (!self->_stopping.load(std::memory_order_relaxed) && self->Step()) {
+    }
+}
+#endif
+
+nonstd::span<const uint8_t> RomHasher::ReadBlock(size_t buffer) noexcept {
+    // Mapped files don't need a buffer unless they're byte-swapped; the view comes straight from the mapping
+    std::vector<uint8_t>& storage = _buffers[buffer];
+    nonstd::span<const uint8_t> block = _file.Read(_blockSize, storage.empty() ? nullptr : storage.data());
+    if (_layout.swapWidth < 2 || block.empty())
+        return block;
+
+    // Swapped from the mapping into the buffer, or within the buffer it was just read into;
+    // either way there's never more than the two blocks in flight
+    ByteSwap(block, storage.data(), _layout.swapWidth);
+    return { storage.data(), block.size() };
+}
+
+bool RomHasher::Step() noexcept {
+    if (GetStatus() != Status::Hashing)
+        return false;
+
+    if (!_primed) {
+        _block = ReadBlock(_currentBuffer);
+        _primed = true;
+    }
+
+    uint64_t hashed = _bytesHashed.load(std::memory_order_relaxed);
+    if (_block.empty()) {
+        // An unreadable or truncated ROM stops short of its reported size
+        bool complete = hashed == _hashes.size;
+        if (complete) {
+            _hashes.md5 = _md5.Finish();
+            _hashes.sha1 = _sha1.Finish();
+        }
+        _file.Close();
+        _status.store(complete ? Status::Done : Status::Failed, std::memory_order_release);
+        return false;
+    }
+
+    const nonstd::span<const uint8_t> block = _block;
+    const size_t pieces = _pieceCrcs.size();
+    const size_t pieceLength = (block.size() + pieces - 1) / pieces;
+    nonstd::span<const uint8_t> next {};
+
+    auto task = [&](size_t i) noexcept {
+        switch (i) {
+            case 0:
+                _md5.Update(block);
+                break;
+            case 1:
+                _sha1.Update(block);
+                break;
+            case 2:
+                next = ReadBlock(_currentBuffer ^ 1);
+                break;
+            default: {
+                size_t piece = i - SERIAL_TASKS;
+                size_t offset = std::min(piece * pieceLength, block.size());
+                size_t length = std::min(pieceLength, block.size() - offset);
+                _pieceCrcs[piece] = Crc32Update(0, block.subspan(offset, length));
+                break;
+            }
+        }
+    };
+    _pool->Run(SERIAL_TASKS + pieces, task);
+
+    for (size_t piece = 0; piece < pieces; ++piece) {
+        size_t offset = std::min(piece * pieceLength, block.size());
+        size_t length = std::min(pieceLength, block.size() - offset);
+        _hashes.crc32 = Crc32Combine(_hashes.crc32, _pieceCrcs[piece], length);
+    }
+
+    _block = next;
+    _currentBuffer ^= 1;
+    _bytesHashed.store(hashed + block.size(), std::memory_order_release);
+    return true;
+}
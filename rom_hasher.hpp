@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#ifdef HAVE_THREADS
+#include <rthreads/rthreads.h>
+#endif
+
+#include "checksum.hpp"
+#include "rom_file.hpp"
+#include "rom_format.hpp"
+#include "worker_pool.hpp"
+
+// Big enough that each step's thread handoffs are lost in the hashing, small enough to keep progress moving
+constexpr size_t ROM_HASH_BLOCK_SIZE = 8 * 1024 * 1024;
+
+// Hashes of the canonical image, after any header's been skipped and any byte-swapping undone
+struct RomHashes {
+    RomFormat format = RomFormat::Raw;
+    uint64_t size = 0;
+    uint32_t crc32 = 0;
+    Md5Digest md5 {};
+    Sha1Digest sha1 {};
+};
+
+// Computes a ROM's CRC-32, MD5 and SHA-1 in one pass, a block at a time.
+// Within each block, MD5 and SHA-1 run on their own threads, CRC-32 is split across whichever threads are left,
+// and the next block is read (or paged in, then normalized) at the same time.
+class RomHasher {
+public:
+    enum class Status {
+        Idle,    // Nothing's open
+        Hashing,
+        Done,
+        Failed,  // Couldn't read the whole ROM
+    };
+
+    RomHasher() noexcept = default;
+    ~RomHasher() noexcept;
+    RomHasher(const RomHasher&) = delete;
+    RomHasher& operator=(const RomHasher&) = delete;
+    RomHasher(RomHasher&&) = delete;
+    RomHasher& operator=(RomHasher&&) = delete;
+
+    // Opens the ROM, works out how to normalize it, and sets up `threads` threads (counting whichever one calls Step) to hash it with.
+    bool Open(const char* path, size_t threads, size_t blockSize = ROM_HASH_BLOCK_SIZE);
+
+    // Takes hashes worked out in an earlier session instead of opening the ROM; the status is then Done
+    void Restore(const RomHashes& hashes) noexcept;
+
+    // Hashes the whole ROM on a background thread; returns false if the thread couldn't be started,
+    // in which case the caller has to Step through it instead.
+    bool Start() noexcept;
+
+    // Hashes the next block on the calling thread; returns false once there's nothing left to do.
+    // Don't call this while a background thread started by Start is running.
+    bool Step() noexcept;
+
+    [[nodiscard]] Status GetStatus() const noexcept { return _status.load(std::memory_order_acquire); }
+    [[nodiscard]] uint64_t GetSize() const noexcept { return _hashes.size; }
+
+    // Safe to call from any thread at any time
+    [[nodiscard]] uint64_t GetBytesHashed() const noexcept { return _bytesHashed.load(std::memory_order_acquire); }
+
+    // Only meaningful once the status is Done
+    [[nodiscard]] const RomHashes& GetHashes() const noexcept { return _hashes; }
+
+private:
+    RomFile _file {};
+    std::unique_ptr<WorkerPool> _pool;
+    RomLayout _layout {};
+    std::vector<uint8_t> _buffers[2]; // Only used if the file isn't mapped, or has to be byte-swapped
+    size_t _currentBuffer = 0;
+    size_t _blockSize = ROM_HASH_BLOCK_SIZE;
+    nonstd::span<const uint8_t> _block {}; // Read, but not hashed yet
+    bool _primed = false; // Whether the first block has been read
+
+    Md5 _md5 {};
+    Sha1 _sha1 {};
+    std::vector<uint32_t> _pieceCrcs; // One per piece of the block that CRC-32 is split into
+    RomHashes _hashes {};
+
+    std::atomic<Status> _status {Status::Idle};
+    std::atomic<uint64_t> _bytesHashed {0};
+
+#ifdef HAVE_THREADS
+    sthread_t* _thread = nullptr;
+    std::atomic<bool> _stopping {false};
+
+    static void ThreadMain(void* hasher);
+#endif
+
+    void Stop() noexcept;
+    [[nodiscard]] nonstd::span<const uint8_t> ReadBlock(size_t buffer) noexcept;
+};
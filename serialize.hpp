@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include <nonstd/span.hpp>
+
+// Identifies a ROM cleaner savestate ("RCLN" when read as little-endian bytes)
+constexpr uint32_t STATE_MAGIC = 0x4E4C4352;
+
+// Bump this whenever the layout of any serialized state changes
+constexpr uint32_t STATE_VERSION = 4;
+
+// Writes plain values into a savestate buffer in native byte order.
+// Without a buffer it only counts bytes, which is how the size of a state is measured.
+// Never allocates, so it's safe to use every frame (e.g. for rewind or run-ahead).
+class StateWriter {
+public:
+    StateWriter() noexcept = default;
+    explicit StateWriter(nonstd::span<uint8_t> buffer) noexcept : _buffer(buffer), _counting(false) {}
+
+    template<typename T>
+    void Write(const T& value) noexcept {
+        static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be written directly");
+        WriteBytes(&value, sizeof(T));
+    }
+
+    void Write(bool value) noexcept {
+        Write<uint8_t>(value ? 1 : 0);
+    }
+
+    // Sizes and indexes are written at a fixed width, so states don't depend on the target's size_t
+    void WriteSize(size_t value) noexcept {
+        Write<uint64_t>(value);
+    }
+
+    template<typename T>
+    void WriteArray(nonstd::span<const T> values) noexcept {
+        static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be written directly");
+        WriteBytes(values.data(), values.size_bytes());
+    }
+
+    // The number of bytes written (or that would have been written) so far
+    [[nodiscard]] size_t GetSize() const noexcept { return _position; }
+
+    // False if the buffer was too small for everything that was written
+    [[nodiscard]] bool IsOk() const noexcept { return !_overflow; }
+
+private:
+    nonstd::span<uint8_t> _buffer {};
+    size_t _position = 0;
+    bool _counting = true;
+    bool _overflow = false;
+
+    void WriteBytes(const void* data, size_t size) noexcept {
+        if (!_counting) {
+            if (_overflow || size > _buffer.size() - _position) {
+                _overflow = true;
+                return;
+            }
+            memcpy(_buffer.data() + _position, data, size);
+        }
+        _position += size;
+    }
+};
+
+// Reads values written by StateWriter, in the same order.
+// Once a read runs past the end of the buffer, it and all later reads fail.
+class StateReader {
+public:
+    explicit StateReader(nonstd::span<const uint8_t> buffer) noexcept : _buffer(buffer) {}
+
+    template<typename T>
+    bool Read(T& value) noexcept {
+        static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be read directly");
+        return ReadBytes(&value, sizeof(T));
+    }
+
+    bool Read(bool& value) noexcept {
+        uint8_t byte = 0;
+        if (!Read(byte) || byte > 1) {
+            _ok = false;
+            return false;
+        }
+        value = byte != 0;
+        return true;
+    }
+
+    bool ReadSize(size_t& value) noexcept {
+        uint64_t wide = 0;
+        if (!Read(wide) || wide > SIZE_MAX) {
+            _ok = false;
+            return false;
+        }
+        value = static_cast<size_t>(wide);
+        return true;
+    }
+
+    template<typename T>
+    bool ReadArray(nonstd::span<T> values) noexcept {
+        static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be read directly");
+        return ReadBytes(values.data(), values.size_bytes());
+    }
+
+    // Marks the state as invalid, e.g. when a value that was read is out of range
+    void Fail() noexcept { _ok = false; }
+
+    [[nodiscard]] size_t GetPosition() const noexcept { return _position; }
+    [[nodiscard]] bool IsOk() const noexcept { return _ok; }
+
+private:
+    nonstd::span<const uint8_t> _buffer;
+    size_t _position = 0;
+    bool _ok = true;
+
+    bool ReadBytes(void* data, size_t size) noexcept {
+        if (!_ok || size > _buffer.size() - _position) {
+            _ok = false;
+            return false;
+        }
+        memcpy(data, _buffer.data() + _position, size);
+        _position += size;
+        return true;
+    }
+};
@@ -0,0 +1,120 @@
+#include "sprites.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <retro_assert.h>
+
+#ifdef HAVE_BAKED_SPRITES
+#include "romcleaner_sprites.h"
+#else
+#include "embedded/romcleaner_cart_png.h"
+#include "embedded/romcleaner_dust00_png.h"
+#include "embedded/romcleaner_dust01_png.h"
+#include "embedded/romcleaner_dust02_png.h"
+#include "embedded/romcleaner_dust03_png.h"
+#include "embedded/romcleaner_dust04_png.h"
+#include "embedded/romcleaner_dust05_png.h"
+#include "embedded/romcleaner_sparkle00_png.h"
+#include "embedded/romcleaner_sparkle01_png.h"
+#include "embedded/romcleaner_sparkle02_png.h"
+#endif
+
+namespace {
+#ifdef HAVE_BAKED_SPRITES
+    static_assert(sizeof(pntr_color) == sizeof(uint32_t), "Baked pixels must match pntr_color's layout");
+
+    struct BakedSprite {
+        const uint32_t* pixels;
+        int width;
+        int height;
+    };
+
+#define BAKED_SPRITE(name) BakedSprite { baked_##name##_pixels, baked_##name##_width, baked_##name##_height }
+
+    // In the same order as Sprite
+    const std::array<BakedSprite, SPRITE_COUNT> SOURCES = {
+        BAKED_SPRITE(romcleaner_cart),
+        BAKED_SPRITE(romcleaner_dust00),
+        BAKED_SPRITE(romcleaner_dust01),
+        BAKED_SPRITE(romcleaner_dust02),
+        BAKED_SPRITE(romcleaner_dust03),
+        BAKED_SPRITE(romcleaner_dust04),
+        BAKED_SPRITE(romcleaner_dust05),
+        BAKED_SPRITE(romcleaner_sparkle00),
+        BAKED_SPRITE(romcleaner_sparkle01),
+        BAKED_SPRITE(romcleaner_sparkle02),
+    };
+
+#undef BAKED_SPRITE
+#else
+    // In the same order as Sprite
+    const std::array<nonstd::span<const uint8_t>, SPRITE_COUNT> SOURCES = {
+        nonstd::span { embedded_romcleaner_cart_png, sizeof(embedded_romcleaner_cart_png) },
+        { embedded_romcleaner_dust00_png, sizeof(embedded_romcleaner_dust00_png) },
+        { embedded_romcleaner_dust01_png, sizeof(embedded_romcleaner_dust01_png) },
+        { embedded_romcleaner_dust02_png, sizeof(embedded_romcleaner_dust02_png) },
+        { embedded_romcleaner_dust03_png, sizeof(embedded_romcleaner_dust03_png) },
+        { embedded_romcleaner_dust04_png, sizeof(embedded_romcleaner_dust04_png) },
+        { embedded_romcleaner_dust05_png, sizeof(embedded_romcleaner_dust05_png) },
+        { embedded_romcleaner_sparkle00_png, sizeof(embedded_romcleaner_sparkle00_png) },
+        { embedded_romcleaner_sparkle01_png, sizeof(embedded_romcleaner_sparkle01_png) },
+        { embedded_romcleaner_sparkle02_png, sizeof(embedded_romcleaner_sparkle02_png) },
+    };
+#endif
+}
+
+SpriteSet::SpriteSet(float scale) noexcept {
+#ifndef HAVE_BAKED_SPRITES
+    _ownsImages = true;
+#endif
+
+    for (size_t i = 0; i < SPRITE_COUNT; ++i) {
+#ifdef HAVE_BAKED_SPRITES
+        const BakedSprite& source = SOURCES[i];
+        pntr_image& image = _wrappers[i];
+
+        // pntr only reads from source images, so the const_cast never leads to a write.
+        // Marking the image as a subimage keeps pntr from ever trying to free the pixels.
+        image.data = reinterpret_cast<pntr_color*>(const_cast<uint32_t*>(source.pixels));
+        image.width = source.width;
+        image.height = source.height;
+        image.pitch = source.width * static_cast<int>(sizeof(pntr_color));
+        image.subimage = true;
+        image.clip = { 0, 0, source.width, source.height };
+        _images[i] = &image;
+#else
+        _images[i] = pntr_load_image_from_memory(PNTR_IMAGE_TYPE_PNG, SOURCES[i].data(), SOURCES[i].size());
+#endif
+        retro_assert(_images[i] != nullptr);
+
+        if (scale != 1.0f) {
+            pntr_image* original = _images[i];
+            int width = std::max(1, static_cast<int>(std::lround(original->width * scale)));
+            int height = std::max(1, static_cast<int>(std::lround(original->height * scale)));
+            _images[i] = pntr_image_resize(original, width, height, PNTR_FILTER_BILINEAR);
+            retro_assert(_images[i] != nullptr);
+
+            if (_ownsImages) {
+                pntr_unload_image(original); // The full-size decoded image isn't needed anymore
+            }
+        }
+    }
+
+    if (scale != 1.0f) {
+        _ownsImages = true;
+    }
+
+    size_t firstParticle = static_cast<size_t>(FIRST_PARTICLE);
+    _particleAtlas = SpriteAtlas({ _images.data() + firstParticle, SPRITE_COUNT - firstParticle });
+}
+
+SpriteSet::~SpriteSet() noexcept {
+    if (_ownsImages) {
+        for (pntr_image* image : _images) {
+            pntr_unload_image(image);
+        }
+    }
+    _images.fill(nullptr);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include <pntr.h>
+
+#include <nonstd/span.hpp>
+
+#include "atlas.hpp"
+
+enum class Sprite : size_t {
+    Cart,
+    Dust00,
+    Dust01,
+    Dust02,
+    Dust03,
+    Dust04,
+    Dust05,
+    Sparkle00,
+    Sparkle01,
+    Sparkle02,
+    Count,
+};
+
+constexpr size_t SPRITE_COUNT = static_cast<size_t>(Sprite::Count);
+
+// Every image the core draws, ready to be blitted.
+// With HAVE_BAKED_SPRITES the images wrap pixel arrays that were decoded at build time,
+// so nothing is decoded or copied; otherwise the embedded PNGs are decoded here, once.
+// At any scale other than 1 every image is resampled once, up front, into an image of its own.
+// The particle frames are also packed into one atlas so they can be drawn in batches.
+// Everything else borrows these images, so the set must outlive whatever uses it.
+class SpriteSet {
+public:
+    explicit SpriteSet(float scale = 1.0f) noexcept;
+    ~SpriteSet() noexcept;
+
+    // The images may point into this object, so it stays put
+    SpriteSet(const SpriteSet&) = delete;
+    SpriteSet& operator=(const SpriteSet&) = delete;
+    SpriteSet(SpriteSet&&) = delete;
+    SpriteSet& operator=(SpriteSet&&) = delete;
+
+    [[nodiscard]] pntr_image* Get(Sprite sprite) const noexcept {
+        return _images[static_cast<size_t>(sprite)];
+    }
+
+    [[nodiscard]] SpriteFrames GetDust() const noexcept {
+        return GetParticleFrames(Sprite::Dust00, Sprite::Sparkle00);
+    }
+
+    [[nodiscard]] SpriteFrames GetSparkles() const noexcept {
+        return GetParticleFrames(Sprite::Sparkle00, Sprite::Count);
+    }
+
+private:
+    // Atlas frame 0 is the first particle sprite
+    static constexpr Sprite FIRST_PARTICLE = Sprite::Dust00;
+
+    std::array<pntr_image*, SPRITE_COUNT> _images {};
+    bool _ownsImages = false; // Whether the images must be unloaded along with the set
+#ifdef HAVE_BAKED_SPRITES
+    std::array<pntr_image, SPRITE_COUNT> _wrappers {};
+#endif
+    SpriteAtlas _particleAtlas {};
+
+    [[nodiscard]] SpriteFrames GetParticleFrames(Sprite begin, Sprite end) const noexcept {
+        return {
+            &_particleAtlas,
+            static_cast<uint32_t>(static_cast<size_t>(begin) - static_cast<size_t>(FIRST_PARTICLE)),
+            static_cast<uint32_t>(static_cast<size_t>(end) - static_cast<size_t>(begin)),
+        };
+    }
+};
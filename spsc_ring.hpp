@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+#include <nonstd/span.hpp>
+
+// A fixed-size queue between exactly one producer thread and exactly one consumer thread.
+// Both ends are wait-free: neither ever blocks or retries, they just do as much as fits.
+template<typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "Values are copied in bulk");
+
+public:
+    // Producer only. Returns how many values were queued; whatever didn't fit is dropped.
+    size_t Write(nonstd::span<const T> values) noexcept {
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t tail = _tail.load(std::memory_order_acquire);
+        size_t count = std::min(values.size(), Capacity - (head - tail));
+
+        size_t start = head & (Capacity - 1);
+        size_t first = std::min(count, Capacity - start);
+        std::copy_n(values.data(), first, _buffer.data() + start);
+        std::copy_n(values.data() + first, count - first, _buffer.data());
+
+        _head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer only. Returns how many values were dequeued into the front of values.
+    size_t Read(nonstd::span<T> values) noexcept {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        size_t head = _head.load(std::memory_order_acquire);
+        size_t count = std::min(values.size(), head - tail);
+
+        size_t start = tail & (Capacity - 1);
+        size_t first = std::min(count, Capacity - start);
+        std::copy_n(_buffer.data() + start, first, values.data());
+        std::copy_n(_buffer.data(), count - first, values.data() + first);
+
+        _tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    // Each index is only written by one side; keeping them on separate cache lines stops the sides from contending
+    alignas(64) std::atomic<size_t> _head {0}; // Total values ever written
+    alignas(64) std::atomic<size_t> _tail {0}; // Total values ever read
+    std::array<T, Capacity> _buffer {};
+};
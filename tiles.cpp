@@ -0,0 +1,32 @@
+#include "tiles.hpp"
+
+#include <algorithm>
+
+#include "damage.hpp"
+
+TileGrid::TileGrid(int width, int height) noexcept :
+    _width(width),
+    _height(height),
+    _columns((width + TILE_SIZE - 1) / TILE_SIZE),
+    _rows((height + TILE_SIZE - 1) / TILE_SIZE)
+{
+}
+
+pntr_rectangle TileGrid::GetTileRect(int column, int row) const noexcept {
+    int x = column * TILE_SIZE;
+    int y = row * TILE_SIZE;
+    return { x, y, std::min(TILE_SIZE, _width - x), std::min(TILE_SIZE, _height - y) };
+}
+
+TileSpan TileGrid::GetSpan(pntr_rectangle rect) const noexcept {
+    rect = RectIntersection(rect, { 0, 0, _width, _height });
+    if (RectIsEmpty(rect))
+        return {};
+
+    return {
+        rect.x / TILE_SIZE,
+        rect.y / TILE_SIZE,
+        (rect.x + rect.width - 1) / TILE_SIZE + 1,
+        (rect.y + rect.height - 1) / TILE_SIZE + 1,
+    };
+}
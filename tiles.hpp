@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <pntr.h>
+
+// Tiles are square; small enough that a frame has plenty to spread across threads,
+// big enough that most sprites only land in one or two of them.
+constexpr int TILE_SIZE = 64;
+
+// A block of tiles, as [firstColumn, endColumn) x [firstRow, endRow)
+struct TileSpan {
+    int firstColumn = 0;
+    int firstRow = 0;
+    int endColumn = 0;
+    int endRow = 0;
+
+    [[nodiscard]] bool IsEmpty() const noexcept { return endColumn <= firstColumn || endRow <= firstRow; }
+};
+
+// Divides the screen into TILE_SIZE squares, numbered row by row.
+// Tiles along the right and bottom edges are cut short if the screen isn't a multiple of TILE_SIZE.
+class TileGrid {
+public:
+    TileGrid(int width, int height) noexcept;
+
+    [[nodiscard]] int GetColumns() const noexcept { return _columns; }
+    [[nodiscard]] int GetRows() const noexcept { return _rows; }
+    [[nodiscard]] size_t GetTileCount() const noexcept { return static_cast<size_t>(_columns) * _rows; }
+    [[nodiscard]] size_t GetTileIndex(int column, int row) const noexcept {
+        return static_cast<size_t>(row) * _columns + column;
+    }
+
+    [[nodiscard]] pntr_rectangle GetTileRect(int column, int row) const noexcept;
+
+    // The tiles that rect overlaps; empty if it's entirely off-screen.
+    [[nodiscard]] TileSpan GetSpan(pntr_rectangle rect) const noexcept;
+
+private:
+    int _width;
+    int _height;
+    int _columns;
+    int _rows;
+};
@@ -0,0 +1,70 @@
+// Decodes PNG sprites on the build machine and writes them out as a C++ header of raw pixels,
+// so that the core can draw them without decoding anything at runtime.
+//
+// Usage: romcleaner_bake_sprites <output.h> NAME=file.png [NAME=file.png ...]
+//
+// For each sprite, the header defines baked_NAME_pixels (in pntr_color order, straight alpha),
+// baked_NAME_width and baked_NAME_height.
+// The pixels are written as 32-bit values, so the header is only valid for targets
+// with the same byte order as the build machine; cross-compiled builds decode PNGs instead.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <pntr.h>
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <output.h> NAME=file.png [NAME=file.png ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE* output = fopen(argv[1], "w");
+    if (!output) {
+        fprintf(stderr, "Failed to open %s for writing\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(output, "// Generated by romcleaner_bake_sprites; do not edit.\n");
+    fprintf(output, "#pragma once\n\n#include <cstdint>\n");
+
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t equals = arg.find('=');
+        if (equals == std::string::npos) {
+            fprintf(stderr, "Expected NAME=file.png, got '%s'\n", argv[i]);
+            fclose(output);
+            return EXIT_FAILURE;
+        }
+
+        std::string name = arg.substr(0, equals);
+        std::string path = arg.substr(equals + 1);
+        pntr_image* image = pntr_load_image(path.c_str());
+        if (!image) {
+            fprintf(stderr, "Failed to decode %s\n", path.c_str());
+            fclose(output);
+            return EXIT_FAILURE;
+        }
+
+        fprintf(output, "\nconstexpr int baked_%s_width = %d;\n", name.c_str(), image->width);
+        fprintf(output, "constexpr int baked_%s_height = %d;\n", name.c_str(), image->height);
+        fprintf(output, "alignas(16) static const uint32_t baked_%s_pixels[] = {", name.c_str());
+
+        // Loaded images are never subimages, so rows are contiguous
+        size_t count = static_cast<size_t>(image->width) * image->height;
+        for (size_t p = 0; p < count; ++p) {
+            fprintf(output, "%s0x%08xu,", p % 8 == 0 ? "\n    " : " ", image->data[p].value);
+        }
+        fprintf(output, "\n};\n");
+
+        pntr_unload_image(image);
+    }
+
+    if (fclose(output) != 0) {
+        fprintf(stderr, "Failed to write %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,267 @@
+// Measures how fast and how accurately BlowDetector runs over a labelled corpus of recordings.
+//
+// Usage: romcleaner_blowbench [--format json|csv] [--iterations N] [--frame N] [--hop N] [label=file.wav ...]
+//
+// Clips labelled "blow" should be detected, anything else (speech, fan, silence...) shouldn't.
+// Without any files, a built-in corpus of synthesized noise and the embedded fanfare is used.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "blow.hpp"
+#include "constants.hpp"
+#include "corpus.hpp"
+
+namespace {
+    struct Options {
+        bool csv = false;
+        int iterations = 10;
+        BlowDetectorArgs detector {};
+        size_t leadIn = SAMPLE_RATE / 2; // Silence before each clip, so onsets can be timed
+        std::vector<Clip> corpus;
+    };
+
+    struct ClipResult {
+        const Clip* clip = nullptr;
+        size_t frames = 0;
+        size_t truePositives = 0;
+        size_t falsePositives = 0;
+        size_t falseNegatives = 0;
+        std::optional<size_t> latencyFrames; // Frames from the clip's onset to its first detection
+    };
+
+    void PrintUsage(const char* program) {
+        fprintf(stderr, "Usage: %s [--format json|csv] [--iterations N] [--frame N] [--hop N] [label=file.wav ...]\n", program);
+    }
+
+    std::optional<Options> ParseOptions(int argc, char* argv[]) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+
+            if (arg == "--format" && hasValue) {
+                std::string format = argv[++i];
+                if (format != "json" && format != "csv") {
+                    PrintUsage(argv[0]);
+                    return std::nullopt;
+                }
+                options.csv = format == "csv";
+            } else if (arg == "--iterations" && hasValue) {
+                options.iterations = std::max(1, std::atoi(argv[++i]));
+            } else if (arg == "--frame" && hasValue) {
+                options.detector.frameSize = std::strtoul(argv[++i], nullptr, 10);
+            } else if (arg == "--hop" && hasValue) {
+                options.detector.hopSize = std::strtoul(argv[++i], nullptr, 10);
+            } else if (size_t equals = arg.find('='); equals != std::string::npos && arg.rfind("--", 0) != 0) {
+                std::string label = arg.substr(0, equals);
+                std::string path = arg.substr(equals + 1);
+                auto samples = LoadWav(path);
+                if (!samples) {
+                    fprintf(stderr, "Failed to load %s\n", path.c_str());
+                    return std::nullopt;
+                }
+                options.corpus.push_back({path, label, std::move(*samples)});
+            } else {
+                PrintUsage(argv[0]);
+                return std::nullopt;
+            }
+        }
+
+        if (options.corpus.empty()) {
+            options.corpus = GetBuiltInCorpus();
+        }
+
+        return options;
+    }
+
+    // Clip names are file paths, which can contain anything
+    std::string JsonEscape(const std::string& text) {
+        std::string escaped;
+        escaped.reserve(text.size());
+        for (char c : text) {
+            switch (c) {
+                case '"': escaped += "\\\""; break;
+                case '\\': escaped += "\\\\"; break;
+                case '\n': escaped += "\\n"; break;
+                case '\r': escaped += "\\r"; break;
+                case '\t': escaped += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char code[8];
+                        snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(c));
+                        escaped += code;
+                    } else {
+                        escaped += c;
+                    }
+            }
+        }
+        return escaped;
+    }
+
+    // RFC 4180: every field is quoted, and quotes inside it are doubled
+    std::string CsvEscape(const std::string& text) {
+        std::string escaped = "\"";
+        for (char c : text) {
+            escaped += c;
+            if (c == '"') {
+                escaped += '"';
+            }
+        }
+        escaped += '"';
+        return escaped;
+    }
+
+    std::vector<int16_t> WithLeadIn(const Clip& clip, size_t leadIn) {
+        std::vector<int16_t> samples(leadIn, 0);
+        samples.insert(samples.end(), clip.samples.begin(), clip.samples.end());
+        return samples;
+    }
+
+    // Feeds the clip one hop at a time so that every decision can be checked against the label
+    ClipResult Evaluate(const Clip& clip, const Options& options) {
+        BlowDetector detector(options.detector);
+        const BlowDetectorArgs& args = detector.GetArgs();
+        std::vector<int16_t> samples = WithLeadIn(clip, options.leadIn);
+
+        ClipResult result {};
+        result.clip = &clip;
+        size_t onsetFrame = 0;
+        bool inClip = false;
+
+        for (size_t offset = 0; offset < samples.size(); offset += args.hopSize) {
+            size_t count = std::min(args.hopSize, samples.size() - offset);
+            if (detector.Push({samples.data() + offset, count}) == 0)
+                continue;
+
+            // A frame counts as part of the clip once it ends inside of it
+            bool expected = clip.IsBlow() && offset + count > options.leadIn;
+            bool detected = detector.IsBlowing();
+
+            if (expected && !inClip) {
+                inClip = true;
+                onsetFrame = result.frames;
+            }
+
+            if (detected && expected) {
+                ++result.truePositives;
+                if (!result.latencyFrames) {
+                    result.latencyFrames = result.frames - onsetFrame;
+                }
+            } else if (detected) {
+                ++result.falsePositives;
+            } else if (expected) {
+                ++result.falseNegatives;
+            }
+
+            ++result.frames;
+        }
+
+        return result;
+    }
+
+    // Pushes each clip in one go, as fast as possible, and returns the average time per analyzed frame
+    double MeasureNanosecondsPerFrame(const Options& options, size_t& framesAnalyzed) {
+        std::vector<std::vector<int16_t>> inputs;
+        for (const Clip& clip : options.corpus) {
+            inputs.push_back(WithLeadIn(clip, options.leadIn));
+        }
+
+        using Clock = std::chrono::steady_clock;
+        Clock::duration elapsed {};
+        framesAnalyzed = 0;
+
+        for (int i = 0; i < options.iterations; ++i) {
+            for (const auto& samples : inputs) {
+                BlowDetector detector(options.detector);
+
+                Clock::time_point start = Clock::now();
+                framesAnalyzed += detector.Push({samples.data(), samples.size()});
+                elapsed += Clock::now() - start;
+            }
+        }
+
+        if (framesAnalyzed == 0)
+            return 0.0;
+
+        return std::chrono::duration<double, std::nano>(elapsed).count() / framesAnalyzed;
+    }
+
+    double Ratio(size_t numerator, size_t denominator) {
+        return denominator > 0 ? static_cast<double>(numerator) / denominator : 0.0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::optional<Options> options = ParseOptions(argc, argv);
+    if (!options)
+        return EXIT_FAILURE;
+
+    std::vector<ClipResult> results;
+    size_t truePositives = 0, falsePositives = 0, falseNegatives = 0;
+    size_t latencyTotal = 0, latencyCount = 0;
+    for (const Clip& clip : options->corpus) {
+        ClipResult result = Evaluate(clip, *options);
+        truePositives += result.truePositives;
+        falsePositives += result.falsePositives;
+        falseNegatives += result.falseNegatives;
+        if (result.latencyFrames) {
+            latencyTotal += *result.latencyFrames;
+            ++latencyCount;
+        }
+        results.push_back(result);
+    }
+
+    size_t framesAnalyzed = 0;
+    double nsPerFrame = MeasureNanosecondsPerFrame(*options, framesAnalyzed);
+    double framesPerSecond = nsPerFrame > 0.0 ? 1e9 / nsPerFrame : 0.0;
+    double precision = Ratio(truePositives, truePositives + falsePositives);
+    double recall = Ratio(truePositives, truePositives + falseNegatives);
+    double meanLatency = latencyCount > 0 ? static_cast<double>(latencyTotal) / latencyCount : -1.0;
+    double hopMs = 1000.0 * BlowDetector(options->detector).GetArgs().hopSize / SAMPLE_RATE;
+
+    if (options->csv) {
+        printf("clip,label,frames,true_positives,false_positives,false_negatives,latency_frames\n");
+        for (const ClipResult& result : results) {
+            printf("%s,%s,%zu,%zu,%zu,%zu,%lld\n",
+                CsvEscape(result.clip->name).c_str(), CsvEscape(result.clip->label).c_str(), result.frames,
+                result.truePositives, result.falsePositives, result.falseNegatives,
+                result.latencyFrames ? static_cast<long long>(*result.latencyFrames) : -1LL);
+        }
+        printf("\nframes,ns_per_frame,frames_per_second,precision,recall,mean_latency_frames,hop_ms\n");
+        printf("%zu,%.1f,%.1f,%.4f,%.4f,%.2f,%.3f\n",
+            framesAnalyzed, nsPerFrame, framesPerSecond, precision, recall, meanLatency, hopMs);
+        return EXIT_SUCCESS;
+    }
+
+    printf("{\n  \"clips\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const ClipResult& result = results[i];
+        printf("    {\"clip\": \"%s\", \"label\": \"%s\", \"frames\": %zu, \"true_positives\": %zu, "
+               "\"false_positives\": %zu, \"false_negatives\": %zu, \"latency_frames\": ",
+            JsonEscape(result.clip->name).c_str(), JsonEscape(result.clip->label).c_str(), result.frames,
+            result.truePositives, result.falsePositives, result.falseNegatives);
+        if (result.latencyFrames) {
+            printf("%zu}", *result.latencyFrames);
+        } else {
+            printf("null}");
+        }
+        printf("%s\n", i + 1 < results.size() ? "," : "");
+    }
+    printf("  ],\n");
+    printf("  \"frames\": %zu,\n", framesAnalyzed);
+    printf("  \"ns_per_frame\": %.1f,\n", nsPerFrame);
+    printf("  \"frames_per_second\": %.1f,\n", framesPerSecond);
+    printf("  \"precision\": %.4f,\n", precision);
+    printf("  \"recall\": %.4f,\n", recall);
+    printf("  \"mean_latency_frames\": %.2f,\n", meanLatency);
+    printf("  \"hop_ms\": %.3f\n", hopMs);
+    printf("}\n");
+
+    return EXIT_SUCCESS;
+}
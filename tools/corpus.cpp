@@ -0,0 +1,138 @@
+#include "corpus.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+#include <formats/rwav.h>
+#include <streams/file_stream.h>
+
+#include "constants.hpp"
+#include "embedded/romcleaner_fanfare_wav.h"
+
+static int16_t ToSample(double value) noexcept {
+    return static_cast<int16_t>(std::clamp(value, -32768.0, 32767.0));
+}
+
+std::optional<std::vector<int16_t>> DecodeWav(nonstd::span<const uint8_t> wav) {
+    rwav_t decoded {};
+    if (rwav_load(&decoded, wav.data(), wav.size()) != RWAV_ITERATE_DONE) {
+        return std::nullopt;
+    }
+
+    if ((decoded.bitspersample != 8 && decoded.bitspersample != 16) || decoded.numchannels == 0) {
+        rwav_free(&decoded);
+        return std::nullopt;
+    }
+
+    // Downmix to mono
+    std::vector<double> mono(decoded.numsamples);
+    for (size_t i = 0; i < mono.size(); ++i) {
+        double sum = 0.0;
+        for (size_t c = 0; c < decoded.numchannels; ++c) {
+            size_t index = i * decoded.numchannels + c;
+            if (decoded.bitspersample == 16) {
+                sum += static_cast<const int16_t*>(decoded.samples)[index];
+            } else {
+                // 8-bit WAV samples are unsigned
+                sum += (static_cast<const uint8_t*>(decoded.samples)[index] - 128) * 256;
+            }
+        }
+        mono[i] = sum / decoded.numchannels;
+    }
+
+    // Linear resampling is plenty for a benchmark corpus
+    double ratio = static_cast<double>(decoded.samplerate) / SAMPLE_RATE;
+    rwav_free(&decoded);
+
+    if (mono.empty() || ratio <= 0.0) {
+        return std::nullopt;
+    }
+
+    std::vector<int16_t> samples(static_cast<size_t>(mono.size() / ratio));
+    for (size_t i = 0; i < samples.size(); ++i) {
+        double position = i * ratio;
+        size_t index = static_cast<size_t>(position);
+        double fraction = position - index;
+        double next = index + 1 < mono.size() ? mono[index + 1] : mono[index];
+        samples[i] = ToSample(mono[index] + (next - mono[index]) * fraction);
+    }
+
+    return samples;
+}
+
+std::optional<std::vector<int16_t>> LoadWav(const std::string& path) {
+    void* buffer = nullptr;
+    int64_t length = 0;
+    if (!filestream_read_file(path.c_str(), &buffer, &length)) {
+        return std::nullopt;
+    }
+
+    auto samples = DecodeWav({static_cast<const uint8_t*>(buffer), static_cast<size_t>(length)});
+    free(buffer);
+    return samples;
+}
+
+std::vector<int16_t> GenerateSilence(size_t samples) {
+    return std::vector<int16_t>(samples, 0);
+}
+
+std::vector<int16_t> GenerateFanNoise(size_t samples, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> noise(0.0, 600.0);
+
+    std::vector<int16_t> output(samples);
+    for (size_t i = 0; i < samples; ++i) {
+        double hum = 150.0 * std::sin(2.0 * M_PI * 60.0 * i / SAMPLE_RATE);
+        output[i] = ToSample(noise(rng) + hum);
+    }
+
+    return output;
+}
+
+std::vector<int16_t> GenerateBlow(size_t samples, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> noise(0.0, 1.0);
+
+    // Four cascaded one-pole low-pass filters at about 300 Hz
+    constexpr double cutoff = 300.0;
+    const double alpha = 1.0 - std::exp(-2.0 * M_PI * cutoff / SAMPLE_RATE);
+    std::array<double, 4> state {};
+
+    std::vector<int16_t> output(samples);
+    for (size_t i = 0; i < samples; ++i) {
+        double value = noise(rng);
+        for (double& s : state) {
+            s += alpha * (value - s);
+            value = s;
+        }
+
+        // Breath swells in and fades out over a few tens of milliseconds
+        double t = static_cast<double>(i) / SAMPLE_RATE;
+        double remaining = static_cast<double>(samples - i) / SAMPLE_RATE;
+        double envelope = std::min({1.0, t / 0.03, remaining / 0.05});
+        output[i] = ToSample(value * 60000.0 * envelope);
+    }
+
+    return output;
+}
+
+std::vector<Clip> GetBuiltInCorpus() {
+    std::vector<Clip> corpus;
+    corpus.push_back({"silence", "silence", GenerateSilence(SAMPLE_RATE * 2)});
+    corpus.push_back({"fan", "fan", GenerateFanNoise(SAMPLE_RATE * 2, 1)});
+
+    for (uint32_t seed = 0; seed < 4; ++seed) {
+        size_t length = SAMPLE_RATE / 2 + seed * SAMPLE_RATE / 4;
+        corpus.push_back({"blow" + std::to_string(seed), "blow", GenerateBlow(length, 100 + seed)});
+    }
+
+    auto fanfare = DecodeWav({embedded_romcleaner_fanfare_wav, sizeof(embedded_romcleaner_fanfare_wav)});
+    if (fanfare) {
+        corpus.push_back({"fanfare", "music", std::move(*fanfare)});
+    }
+
+    return corpus;
+}
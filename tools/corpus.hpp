@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <nonstd/span.hpp>
+
+// Sample sources for exercising BlowDetector without a real microphone.
+// Everything is mono 16-bit PCM at SAMPLE_RATE.
+
+struct Clip {
+    std::string name;
+    std::string label; // "blow" clips should be detected, anything else shouldn't
+    std::vector<int16_t> samples;
+
+    [[nodiscard]] bool IsBlow() const noexcept { return label == "blow"; }
+};
+
+// Decodes a WAV file in memory, downmixing to mono and resampling to SAMPLE_RATE.
+std::optional<std::vector<int16_t>> DecodeWav(nonstd::span<const uint8_t> wav);
+std::optional<std::vector<int16_t>> LoadWav(const std::string& path);
+
+std::vector<int16_t> GenerateSilence(size_t samples);
+
+// Broadband noise with a little mains hum, like a fan or air conditioner
+std::vector<int16_t> GenerateFanNoise(size_t samples, uint32_t seed);
+
+// Loud noise concentrated below a few hundred Hz, like breath hitting a microphone
+std::vector<int16_t> GenerateBlow(size_t samples, uint32_t seed);
+
+// A small corpus that needs no files: silence, fan noise, synthesized blows and the embedded fanfare
+std::vector<Clip> GetBuiltInCorpus();
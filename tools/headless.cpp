@@ -0,0 +1,531 @@
+// Runs the core without a frontend, as fast as possible, and reports how long each frame took.
+//
+// Usage: romcleaner_headless <core> [--frames N] [--content PATH] [--mic SCRIPT | --mic-wav FILE]
+//                            [--option KEY=VALUE ...] [--format json|csv]
+//
+// The microphone is simulated. A script is a comma-separated list of "source:seconds" segments,
+// where a source is silence, fan or blow (e.g. "silence:2,blow:4,silence:1");
+// alternatively, a WAV file can be looped. Samples are delivered at the rate they'd be recorded,
+// i.e. one video frame's worth per retro_run.
+//
+// Any performance counters the core registers through the libretro perf interface
+// are reported per frame alongside the host's own measurements.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <dlfcn.h>
+#include <libretro.h>
+
+#include "constants.hpp"
+#include "corpus.hpp"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        std::string core;
+        std::string content = "headless.rom"; // The core only checks that there's a path
+        size_t frames = 3600;
+        std::string micScript = "silence:2,blow:4,silence:1";
+        std::string micWav;
+        std::map<std::string, std::string> variables;
+        bool csv = false;
+        bool verbose = false;
+    };
+
+    struct Core {
+        void* handle = nullptr;
+        void (*set_environment)(retro_environment_t) = nullptr;
+        void (*set_video_refresh)(retro_video_refresh_t) = nullptr;
+        void (*set_audio_sample)(retro_audio_sample_t) = nullptr;
+        void (*set_audio_sample_batch)(retro_audio_sample_batch_t) = nullptr;
+        void (*set_input_poll)(retro_input_poll_t) = nullptr;
+        void (*set_input_state)(retro_input_state_t) = nullptr;
+        void (*init)() = nullptr;
+        void (*deinit)() = nullptr;
+        void (*get_system_av_info)(retro_system_av_info*) = nullptr;
+        bool (*load_game)(const retro_game_info*) = nullptr;
+        void (*unload_game)() = nullptr;
+        void (*run)() = nullptr;
+    };
+
+    // Per-frame durations for one phase, in microseconds
+    struct Phase {
+        std::string name;
+        std::vector<double> samples;
+    };
+
+    Options _options;
+    std::vector<int16_t> _micSamples;
+    size_t _micPosition = 0;
+    size_t _micBudget = 0; // Samples the fake microphone has "recorded" but not yet handed out
+    bool _micOpen = false;
+    bool _micEnabled = false;
+
+    Clock::time_point _runStart;
+    double _untilVideo = 0.0; // Time from the start of retro_run to the video callback
+    double _videoCallback = 0.0;
+    double _audioCallback = 0.0;
+    std::array<int16_t, MAX_SAMPLES_PER_FRAME * 2> _audioSink {}; // Stands in for the frontend's audio buffer
+    size_t _dupedFrames = 0;
+
+    std::vector<retro_perf_counter*> _counters;
+
+    double MicrosecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    }
+
+    void Log(retro_log_level level, const char* fmt, ...) {
+        if (level < RETRO_LOG_WARN && !_options.verbose)
+            return;
+
+        va_list args;
+        va_start(args, fmt);
+        vfprintf(stderr, fmt, args);
+        va_end(args);
+    }
+
+    retro_microphone_t* OpenMic(const retro_microphone_params_t*) {
+        _micOpen = true;
+        return reinterpret_cast<retro_microphone_t*>(&_micSamples);
+    }
+
+    void CloseMic(retro_microphone_t*) {
+        _micOpen = false;
+    }
+
+    bool GetMicParams(const retro_microphone_t*, retro_microphone_params_t* params) {
+        params->rate = SAMPLE_RATE;
+        return true;
+    }
+
+    bool SetMicState(retro_microphone_t*, bool state) {
+        _micEnabled = state;
+        return true;
+    }
+
+    bool GetMicState(const retro_microphone_t*) {
+        return _micEnabled;
+    }
+
+    int ReadMic(retro_microphone_t*, int16_t* samples, size_t count) {
+        if (!_micOpen || !_micEnabled || _micSamples.empty())
+            return 0;
+
+        count = std::min(count, _micBudget);
+        for (size_t i = 0; i < count; ++i) {
+            samples[i] = _micSamples[_micPosition];
+            _micPosition = (_micPosition + 1) % _micSamples.size();
+        }
+        _micBudget -= count;
+
+        return static_cast<int>(count);
+    }
+
+    retro_time_t GetTimeUsec() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    retro_perf_tick_t GetPerfCounter() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    uint64_t GetCpuFeatures() {
+        return 0;
+    }
+
+    void PerfRegister(retro_perf_counter* counter) {
+        counter->registered = true;
+        _counters.push_back(counter);
+    }
+
+    void PerfStart(retro_perf_counter* counter) {
+        counter->call_cnt++;
+        counter->start = GetPerfCounter();
+    }
+
+    void PerfStop(retro_perf_counter* counter) {
+        counter->total += GetPerfCounter() - counter->start;
+    }
+
+    void PerfLog() {
+        for (const retro_perf_counter* counter : _counters) {
+            Log(RETRO_LOG_INFO, "[perf] %s: %llu calls, %llu ns\n", counter->ident,
+                static_cast<unsigned long long>(counter->call_cnt), static_cast<unsigned long long>(counter->total));
+        }
+    }
+
+    bool Environment(unsigned cmd, void* data) {
+        switch (cmd) {
+            case RETRO_ENVIRONMENT_GET_LOG_INTERFACE:
+                static_cast<retro_log_callback*>(data)->log = Log;
+                return true;
+            case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
+                return *static_cast<const retro_pixel_format*>(data) == RETRO_PIXEL_FORMAT_XRGB8888;
+            case RETRO_ENVIRONMENT_GET_CAN_DUPE:
+                *static_cast<bool*>(data) = true;
+                return true;
+            case RETRO_ENVIRONMENT_SET_MESSAGE_EXT:
+                return true;
+            case RETRO_ENVIRONMENT_GET_MICROPHONE_INTERFACE: {
+                auto* mic = static_cast<retro_microphone_interface*>(data);
+                if (mic->interface_version != RETRO_MICROPHONE_INTERFACE_VERSION)
+                    return false;
+
+                mic->open_mic = OpenMic;
+                mic->close_mic = CloseMic;
+                mic->get_params = GetMicParams;
+                mic->set_mic_state = SetMicState;
+                mic->get_mic_state = GetMicState;
+                mic->read_mic = ReadMic;
+                return true;
+            }
+            case RETRO_ENVIRONMENT_GET_PERF_INTERFACE: {
+                auto* perf = static_cast<retro_perf_callback*>(data);
+                perf->get_time_usec = GetTimeUsec;
+                perf->get_cpu_features = GetCpuFeatures;
+                perf->get_perf_counter = GetPerfCounter;
+                perf->perf_register = PerfRegister;
+                perf->perf_start = PerfStart;
+                perf->perf_stop = PerfStop;
+                perf->perf_log = PerfLog;
+                return true;
+            }
+            case RETRO_ENVIRONMENT_GET_VARIABLE: {
+                auto* variable = static_cast<retro_variable*>(data);
+                auto it = _options.variables.find(variable->key);
+                variable->value = it != _options.variables.end() ? it->second.c_str() : nullptr;
+                return variable->value != nullptr;
+            }
+            case RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE:
+                *static_cast<bool*>(data) = false;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void VideoRefresh(const void* data, unsigned, unsigned, size_t) {
+        _untilVideo = MicrosecondsSince(_runStart);
+        if (!data) {
+            ++_dupedFrames;
+        }
+
+        Clock::time_point start = Clock::now();
+        // A real frontend would upload the frame here; touching one pixel keeps the pointer honest
+        if (data) {
+            volatile uint32_t pixel = *static_cast<const uint32_t*>(data);
+            (void)pixel;
+        }
+        _videoCallback = MicrosecondsSince(start);
+    }
+
+    void AudioSample(int16_t, int16_t) {}
+
+    size_t AudioSampleBatch(const int16_t* data, size_t frames) {
+        Clock::time_point start = Clock::now();
+        // A real frontend would at least copy the samples into its own buffer before resampling them
+        size_t samples = std::min(frames * 2, _audioSink.size());
+        if (data) {
+            memcpy(_audioSink.data(), data, samples * sizeof(int16_t));
+        }
+        _audioCallback += MicrosecondsSince(start);
+        return frames;
+    }
+
+    void InputPoll() {}
+
+    int16_t InputState(unsigned, unsigned, unsigned, unsigned) {
+        return 0;
+    }
+
+    template<typename T>
+    bool Bind(void* handle, T& function, const char* name) {
+        function = reinterpret_cast<T>(dlsym(handle, name));
+        if (!function) {
+            fprintf(stderr, "Core is missing %s\n", name);
+        }
+        return function != nullptr;
+    }
+
+    std::optional<Core> LoadCore(const std::string& path) {
+        Core core;
+        core.handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!core.handle) {
+            fprintf(stderr, "Failed to load %s: %s\n", path.c_str(), dlerror());
+            return std::nullopt;
+        }
+
+        bool ok = Bind(core.handle, core.set_environment, "retro_set_environment")
+            && Bind(core.handle, core.set_video_refresh, "retro_set_video_refresh")
+            && Bind(core.handle, core.set_audio_sample, "retro_set_audio_sample")
+            && Bind(core.handle, core.set_audio_sample_batch, "retro_set_audio_sample_batch")
+            && Bind(core.handle, core.set_input_poll, "retro_set_input_poll")
+            && Bind(core.handle, core.set_input_state, "retro_set_input_state")
+            && Bind(core.handle, core.init, "retro_init")
+            && Bind(core.handle, core.deinit, "retro_deinit")
+            && Bind(core.handle, core.get_system_av_info, "retro_get_system_av_info")
+            && Bind(core.handle, core.load_game, "retro_load_game")
+            && Bind(core.handle, core.unload_game, "retro_unload_game")
+            && Bind(core.handle, core.run, "retro_run");
+
+        if (!ok) {
+            dlclose(core.handle);
+            return std::nullopt;
+        }
+
+        return core;
+    }
+
+    std::optional<std::vector<int16_t>> BuildMicSamples() {
+        if (!_options.micWav.empty()) {
+            return LoadWav(_options.micWav);
+        }
+
+        std::vector<int16_t> samples;
+        size_t start = 0;
+        const std::string& script = _options.micScript;
+        while (start < script.size()) {
+            size_t end = script.find(',', start);
+            std::string segment = script.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            start = end == std::string::npos ? script.size() : end + 1;
+
+            size_t colon = segment.find(':');
+            if (colon == std::string::npos) {
+                fprintf(stderr, "Expected source:seconds in mic script, got '%s'\n", segment.c_str());
+                return std::nullopt;
+            }
+
+            std::string source = segment.substr(0, colon);
+            size_t count = static_cast<size_t>(std::atof(segment.c_str() + colon + 1) * SAMPLE_RATE);
+            std::vector<int16_t> chunk;
+            if (source == "silence") {
+                chunk = GenerateSilence(count);
+            } else if (source == "fan") {
+                chunk = GenerateFanNoise(count, static_cast<uint32_t>(samples.size()));
+            } else if (source == "blow") {
+                chunk = GenerateBlow(count, static_cast<uint32_t>(samples.size()));
+            } else {
+                fprintf(stderr, "Unknown mic source '%s'\n", source.c_str());
+                return std::nullopt;
+            }
+            samples.insert(samples.end(), chunk.begin(), chunk.end());
+        }
+
+        return samples;
+    }
+
+    void PrintUsage(const char* program) {
+        fprintf(stderr, "Usage: %s <core> [--frames N] [--content PATH] [--mic SCRIPT | --mic-wav FILE] "
+                        "[--option KEY=VALUE ...] [--format json|csv] [--verbose]\n", program);
+    }
+
+    std::optional<Options> ParseOptions(int argc, char* argv[]) {
+        if (argc < 2) {
+            PrintUsage(argv[0]);
+            return std::nullopt;
+        }
+
+        Options options;
+        options.core = argv[1];
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+
+            if (arg == "--frames" && hasValue) {
+                options.frames = std::strtoul(argv[++i], nullptr, 10);
+            } else if (arg == "--content" && hasValue) {
+                options.content = argv[++i];
+            } else if (arg == "--mic" && hasValue) {
+                options.micScript = argv[++i];
+            } else if (arg == "--mic-wav" && hasValue) {
+                options.micWav = argv[++i];
+            } else if (arg == "--option" && hasValue) {
+                std::string option = argv[++i];
+                size_t equals = option.find('=');
+                if (equals == std::string::npos) {
+                    fprintf(stderr, "Expected KEY=VALUE, got '%s'\n", option.c_str());
+                    return std::nullopt;
+                }
+                options.variables[option.substr(0, equals)] = option.substr(equals + 1);
+            } else if (arg == "--format" && hasValue) {
+                std::string format = argv[++i];
+                if (format != "json" && format != "csv") {
+                    PrintUsage(argv[0]);
+                    return std::nullopt;
+                }
+                options.csv = format == "csv";
+            } else if (arg == "--verbose") {
+                options.verbose = true;
+            } else {
+                fprintf(stderr, "Unknown argument '%s'\n", arg.c_str());
+                return std::nullopt;
+            }
+        }
+
+        return options;
+    }
+
+    double Percentile(const std::vector<double>& sorted, double p) {
+        if (sorted.empty())
+            return 0.0;
+
+        size_t index = static_cast<size_t>(std::ceil(p * sorted.size())) - 1;
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+
+    // Counts samples in power-of-two microsecond buckets: [0,1), [1,2), [2,4), [4,8)...
+    std::vector<size_t> Histogram(const std::vector<double>& samples) {
+        std::vector<size_t> buckets;
+        for (double sample : samples) {
+            size_t bucket = sample < 1.0 ? 0 : static_cast<size_t>(std::log2(sample)) + 1;
+            if (buckets.size() <= bucket) {
+                buckets.resize(bucket + 1, 0);
+            }
+            ++buckets[bucket];
+        }
+        return buckets;
+    }
+
+    void Report(std::vector<Phase>& phases, double wallSeconds) {
+        const std::vector<double>& frames = phases.front().samples;
+        double fps = wallSeconds > 0.0 ? frames.size() / wallSeconds : 0.0;
+
+        if (_options.csv) {
+            printf("phase,min_us,avg_us,p50_us,p99_us,max_us\n");
+        } else {
+            printf("{\n  \"frames\": %zu,\n  \"duped_frames\": %zu,\n  \"fps\": %.1f,\n  \"phases\": {\n",
+                frames.size(), _dupedFrames, fps);
+        }
+
+        for (size_t i = 0; i < phases.size(); ++i) {
+            Phase& phase = phases[i];
+            std::vector<double> sorted = phase.samples;
+            std::sort(sorted.begin(), sorted.end());
+
+            double total = 0.0;
+            for (double sample : sorted) {
+                total += sample;
+            }
+
+            double min = sorted.empty() ? 0.0 : sorted.front();
+            double max = sorted.empty() ? 0.0 : sorted.back();
+            double avg = sorted.empty() ? 0.0 : total / sorted.size();
+            double p50 = Percentile(sorted, 0.50);
+            double p99 = Percentile(sorted, 0.99);
+
+            if (_options.csv) {
+                printf("%s,%.2f,%.2f,%.2f,%.2f,%.2f\n", phase.name.c_str(), min, avg, p50, p99, max);
+                continue;
+            }
+
+            printf("    \"%s\": {\"min_us\": %.2f, \"avg_us\": %.2f, \"p50_us\": %.2f, \"p99_us\": %.2f, \"max_us\": %.2f, \"histogram_log2_us\": [",
+                phase.name.c_str(), min, avg, p50, p99, max);
+            std::vector<size_t> histogram = Histogram(phase.samples);
+            for (size_t b = 0; b < histogram.size(); ++b) {
+                printf("%s%zu", b > 0 ? ", " : "", histogram[b]);
+            }
+            printf("]}%s\n", i + 1 < phases.size() ? "," : "");
+        }
+
+        if (!_options.csv) {
+            printf("  }\n}\n");
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::optional<Options> options = ParseOptions(argc, argv);
+    if (!options)
+        return EXIT_FAILURE;
+    _options = std::move(*options);
+
+    std::optional<std::vector<int16_t>> micSamples = BuildMicSamples();
+    if (!micSamples)
+        return EXIT_FAILURE;
+    _micSamples = std::move(*micSamples);
+
+    std::optional<Core> core = LoadCore(_options.core);
+    if (!core)
+        return EXIT_FAILURE;
+
+    core->set_environment(Environment);
+    core->set_video_refresh(VideoRefresh);
+    core->set_audio_sample(AudioSample);
+    core->set_audio_sample_batch(AudioSampleBatch);
+    core->set_input_poll(InputPoll);
+    core->set_input_state(InputState);
+    core->init();
+
+    retro_system_av_info av {};
+    core->get_system_av_info(&av);
+    size_t samplesPerFrame = static_cast<size_t>(SAMPLE_RATE / (av.timing.fps > 0 ? av.timing.fps : FPS));
+
+    retro_game_info game {};
+    game.path = _options.content.c_str();
+    if (!core->load_game(&game)) {
+        fprintf(stderr, "Core failed to load %s\n", game.path);
+        core->deinit();
+        dlclose(core->handle);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Phase> phases {
+        {"retro_run", {}},
+        {"until_video_refresh", {}},
+        {"video_refresh", {}},
+        {"audio_batch", {}},
+    };
+    for (Phase& phase : phases) {
+        phase.samples.reserve(_options.frames);
+    }
+
+    // Core counters are registered lazily, so their phases are added as they appear
+    std::vector<retro_perf_tick_t> previousTotals;
+
+    Clock::time_point wallStart = Clock::now();
+    for (size_t frame = 0; frame < _options.frames; ++frame) {
+        _micBudget = std::min(_micBudget + samplesPerFrame, samplesPerFrame * 4);
+        _untilVideo = _videoCallback = _audioCallback = 0.0;
+
+        _runStart = Clock::now();
+        core->run();
+        double run = MicrosecondsSince(_runStart);
+
+        phases[0].samples.push_back(run);
+        phases[1].samples.push_back(_untilVideo);
+        phases[2].samples.push_back(_videoCallback);
+        phases[3].samples.push_back(_audioCallback);
+
+        for (size_t c = 0; c < _counters.size(); ++c) {
+            if (c >= previousTotals.size()) {
+                previousTotals.push_back(0);
+                phases.push_back({_counters[c]->ident, std::vector<double>(frame, 0.0)});
+            }
+
+            retro_perf_tick_t total = _counters[c]->total;
+            phases[4 + c].samples.push_back((total - previousTotals[c]) / 1000.0);
+            previousTotals[c] = total;
+        }
+    }
+    double wallSeconds = std::chrono::duration<double>(Clock::now() - wallStart).count();
+
+    Report(phases, wallSeconds);
+
+    core->unload_game();
+    core->deinit();
+    dlclose(core->handle);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+#include "worker_pool.hpp"
+
+#include <retro_assert.h>
+
+#ifdef HAVE_THREADS
+WorkerPool::WorkerPool(size_t threads) noexcept {
+    if (threads <= 1)
+        return;
+
+    _lock = slock_new();
+    _start = scond_new();
+    _done = scond_new();
+    retro_assert(_lock != nullptr);
+    retro_assert(_start != nullptr);
+    retro_assert(_done != nullptr);
+
+    _threads.reserve(threads - 1);
+    for (size_t i = 0; i + 1 < threads; ++i) {
+        sthread_t* thread = sthread_create(WorkerMain, this);
+        if (!thread)
+            break; // Make do with however many threads we got
+
+        _threads.push_back(thread);
+    }
+}
+
+WorkerPool::~WorkerPool() noexcept {
+    if (_lock) {
+        slock_lock(_lock);
+        _stopping = true;
+        scond_broadcast(_start);
+        slock_unlock(_lock);
+    }
+
+    for (sthread_t* thread : _threads) {
+        sthread_join(thread);
+    }
+    _threads.clear();
+
+    if (_done) scond_free(_done);
+    if (_start) scond_free(_start);
+    if (_lock) slock_free(_lock);
+}
+
+size_t WorkerPool::GetThreadCount() const noexcept {
+    return _threads.size() + 1;
+}
+
+void WorkerPool::Run(size_t count, Task task, void* context) noexcept {
+    if (_threads.empty() || count <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            task(context, i);
+        }
+        return;
+    }
+
+    slock_lock(_lock);
+    _task = task;
+    _context = context;
+    _count = count;
+    _next.store(0, std::memory_order_relaxed);
+    _busy = _threads.size();
+    ++_generation;
+    scond_broadcast(_start);
+    slock_unlock(_lock);
+
+    RunTasks();
+
+    slock_lock(_lock);
+    while (_busy > 0) {
+        scond_wait(_done, _lock);
+    }
+    slock_unlock(_lock);
+}
+
+void WorkerPool::RunTasks() noexcept {
+    for (size_t i = _next.fetch_add(1, std::memory_order_relaxed); i < _count; i = _next.fetch_add(1, std::memory_order_relaxed)) {
+        _task(_context, i);
+    }
+}
+
+void WorkerPool::WorkerMain(void* userdata) {
+    WorkerPool& pool = *static_cast<WorkerPool*>(userdata);
+    size_t seen = 0;
+
+    slock_lock(pool._lock);
+    while (true) {
+        while (pool._generation == seen && !pool._stopping) {
+            scond_wait(pool._start, pool._lock);
+        }
+
+        if (pool._stopping)
+            break;
+
+        seen = pool._generation;
+        slock_unlock(pool._lock);
+
+        pool.RunTasks();
+
+        slock_lock(pool._lock);
+        if (--pool._busy == 0) {
+            scond_signal(pool._done);
+        }
+    }
+    slock_unlock(pool._lock);
+}
+#else
+WorkerPool::WorkerPool(size_t) noexcept {}
+
+WorkerPool::~WorkerPool() noexcept = default;
+
+size_t WorkerPool::GetThreadCount() const noexcept {
+    return 1;
+}
+
+void WorkerPool::Run(size_t count, Task task, void* context) noexcept {
+    for (size_t i = 0; i < count; ++i) {
+        task(context, i);
+    }
+}
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#ifdef HAVE_THREADS
+#include <rthreads/rthreads.h>
+#endif
+
+// A fixed set of threads that split up batches of independent tasks.
+// The calling thread works on the batch too, and Run only returns once every task is done.
+// Without HAVE_THREADS (or with no extra threads) every task runs inline on the caller.
+class WorkerPool {
+public:
+    using Task = void (*)(void* context, size_t index);
+
+    // Uses `threads` threads in total, counting the one that calls Run.
+    explicit WorkerPool(size_t threads = 1) noexcept;
+    ~WorkerPool() noexcept;
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    WorkerPool(WorkerPool&&) = delete;
+    WorkerPool& operator=(WorkerPool&&) = delete;
+
+    // Calls task(context, i) for every i in [0, count), in no particular order or thread.
+    void Run(size_t count, Task task, void* context) noexcept;
+
+    // Calls function(i) for every i in [0, count); the function must not throw.
+    template<typename Function>
+    void Run(size_t count, Function& function) noexcept {
+        Run(count, [](void* context, size_t index) { (*static_cast<Function*>(context))(index); }, &function);
+    }
+
+    [[nodiscard]] size_t GetThreadCount() const noexcept;
+
+private:
+#ifdef HAVE_THREADS
+    std::vector<sthread_t*> _threads;
+    slock_t* _lock = nullptr;
+    scond_t* _start = nullptr; // Signaled when a new batch is ready, or when the pool is shutting down
+    scond_t* _done = nullptr;  // Signaled when the last worker finishes its part of a batch
+    size_t _generation = 0;    // Incremented for each batch, so workers can tell a new one from a spurious wakeup
+    size_t _busy = 0;          // Workers that haven't finished the current batch
+    bool _stopping = false;
+
+    Task _task = nullptr;
+    void* _context = nullptr;
+    size_t _count = 0;
+    std::atomic<size_t> _next {0};
+
+    static void WorkerMain(void* pool);
+    void RunTasks() noexcept;
+#endif
+};
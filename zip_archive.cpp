@@ -0,0 +1,201 @@
+#include "zip_archive.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace {
+    constexpr uint32_t END_OF_DIRECTORY_SIGNATURE = 0x06054b50;
+    constexpr uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+    constexpr uint32_t ZIP64_RECORD_SIGNATURE = 0x06064b50;
+    constexpr uint32_t DIRECTORY_ENTRY_SIGNATURE = 0x02014b50;
+    constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+
+    constexpr size_t END_OF_DIRECTORY_SIZE = 22;
+    constexpr size_t ZIP64_LOCATOR_SIZE = 20;
+    constexpr size_t DIRECTORY_ENTRY_SIZE = 46;
+
+    constexpr uint16_t ZIP64_EXTRA_FIELD = 0x0001;
+    constexpr uint16_t FLAG_ENCRYPTED = 1 << 0;
+
+    // Everything in a .zip is little-endian
+    uint16_t Load16(const uint8_t* p) noexcept {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    uint32_t Load32(const uint8_t* p) noexcept {
+        return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+    }
+
+    uint64_t Load64(const uint8_t* p) noexcept {
+        return uint64_t(Load32(p)) | (uint64_t(Load32(p + 4)) << 32);
+    }
+
+    // Fills in whichever of the entry's sizes and offset were too big for the central directory's 32-bit fields
+    bool ReadZip64ExtraField(nonstd::span<const uint8_t> extra, ZipEntry& entry) noexcept {
+        while (extra.size() >= 4) {
+            uint16_t id = Load16(extra.data());
+            uint16_t size = Load16(extra.data() + 2);
+            if (extra.size() < 4u + size)
+                return false;
+
+            if (id == ZIP64_EXTRA_FIELD) {
+                nonstd::span<const uint8_t> field = extra.subspan(4, size);
+                for (uint64_t* value : { &entry.size, &entry.compressedSize, &entry.localHeaderOffset }) {
+                    if (*value != UINT32_MAX)
+                        continue;
+                    if (field.size() < 8)
+                        return false;
+                    *value = Load64(field.data());
+                    field = field.subspan(8);
+                }
+                return true;
+            }
+
+            extra = extra.subspan(4u + size);
+        }
+
+        return true;
+    }
+}
+
+bool FindZipDirectory(nonstd::span<const uint8_t> tail, uint64_t tailOffset, ZipDirectoryLocation& location) noexcept {
+    if (tail.size() < END_OF_DIRECTORY_SIZE)
+        return false;
+
+    // The record's comment can contain anything, so search from the end to find the record itself
+    for (size_t i = tail.size() - END_OF_DIRECTORY_SIZE + 1; i-- > 0;) {
+        const uint8_t* record = tail.data() + i;
+        if (Load32(record) != END_OF_DIRECTORY_SIGNATURE)
+            continue;
+
+        if (i + END_OF_DIRECTORY_SIZE + Load16(record + 20) > tail.size())
+            continue;
+
+        // Split archives aren't supported
+        if (Load16(record + 4) != 0 || Load16(record + 6) != 0)
+            return false;
+
+        location.size = Load32(record + 12);
+        location.offset = Load32(record + 16);
+        location.zip64RecordOffset = UINT64_MAX;
+        if (i >= ZIP64_LOCATOR_SIZE && Load32(record - ZIP64_LOCATOR_SIZE) == ZIP64_LOCATOR_SIGNATURE) {
+            location.zip64RecordOffset = Load64(record - ZIP64_LOCATOR_SIZE + 8);
+        }
+
+        return tailOffset + i >= location.offset + location.size || location.zip64RecordOffset != UINT64_MAX;
+    }
+
+    return false;
+}
+
+bool ReadZip64DirectoryRecord(nonstd::span<const uint8_t> record, ZipDirectoryLocation& location) noexcept {
+    if (record.size() < ZIP64_DIRECTORY_RECORD_SIZE || Load32(record.data()) != ZIP64_RECORD_SIGNATURE)
+        return false;
+
+    location.size = Load64(record.data() + 40);
+    location.offset = Load64(record.data() + 48);
+    return true;
+}
+
+bool ReadZipDirectory(nonstd::span<const uint8_t> directory, std::vector<ZipEntry>& entries) {
+    entries.clear();
+    while (directory.size() >= DIRECTORY_ENTRY_SIZE && Load32(directory.data()) == DIRECTORY_ENTRY_SIGNATURE) {
+        const uint8_t* header = directory.data();
+        size_t nameLength = Load16(header + 28);
+        size_t extraLength = Load16(header + 30);
+        size_t commentLength = Load16(header + 32);
+        size_t entrySize = DIRECTORY_ENTRY_SIZE + nameLength + extraLength + commentLength;
+        if (directory.size() < entrySize)
+            return false;
+
+        ZipEntry entry;
+        entry.method = Load16(header + 10);
+        entry.crc32 = Load32(header + 16);
+        entry.compressedSize = Load32(header + 20);
+        entry.size = Load32(header + 24);
+        entry.localHeaderOffset = Load32(header + 42);
+        entry.name.assign(reinterpret_cast<const char*>(header + DIRECTORY_ENTRY_SIZE), nameLength);
+        if (!ReadZip64ExtraField(directory.subspan(DIRECTORY_ENTRY_SIZE + nameLength, extraLength), entry))
+            return false;
+
+        // Encrypted entries can't be read, so they're left out
+        if (!(Load16(header + 8) & FLAG_ENCRYPTED)) {
+            entries.push_back(std::move(entry));
+        }
+
+        directory = directory.subspan(entrySize);
+    }
+
+    return !entries.empty();
+}
+
+bool GetZipDataOffset(nonstd::span<const uint8_t> localHeader, const ZipEntry& entry, uint64_t& offset) noexcept {
+    if (localHeader.size() < ZIP_LOCAL_HEADER_SIZE || Load32(localHeader.data()) != LOCAL_HEADER_SIGNATURE)
+        return false;
+
+    // The local header's name and extra field can differ from the central directory's, so its own lengths are used
+    offset = entry.localHeaderOffset + ZIP_LOCAL_HEADER_SIZE + Load16(localHeader.data() + 26) + Load16(localHeader.data() + 28);
+    return true;
+}
+
+const ZipEntry* SelectZipEntry(const std::vector<ZipEntry>& entries, const char* name) noexcept {
+    const ZipEntry* selected = nullptr;
+    for (const ZipEntry& entry : entries) {
+        if (entry.IsDirectory())
+            continue;
+
+        if (name && *name) {
+            if (entry.name == name)
+                return &entry;
+        } else if (!selected || entry.size > selected->size) {
+            selected = &entry;
+        }
+    }
+
+    return selected;
+}
+
+#ifdef HAVE_ZLIB
+ZipInflater::ZipInflater() noexcept {
+    // Negative window bits mean a raw deflate stream, without zlib's header and trailer
+    _initialized = inflateInit2(&_stream, -MAX_WBITS) == Z_OK;
+}
+
+ZipInflater::~ZipInflater() noexcept {
+    if (_initialized) {
+        inflateEnd(&_stream);
+    }
+}
+
+void ZipInflater::Reset() noexcept {
+    if (_initialized) {
+        inflateReset(&_stream);
+    }
+    _finished = false;
+    _failed = false;
+}
+
+size_t ZipInflater::Inflate(nonstd::span<const uint8_t>& input, nonstd::span<uint8_t> output) noexcept {
+    if (!_initialized || _finished || _failed || output.empty())
+        return 0;
+
+    // zlib counts in 32-bit ints, so bigger spans are done a piece at a time
+    auto inputSize = static_cast<uInt>(std::min<size_t>(input.size(), UINT_MAX));
+    auto outputSize = static_cast<uInt>(std::min<size_t>(output.size(), UINT_MAX));
+    _stream.next_in = const_cast<Bytef*>(input.data());
+    _stream.avail_in = inputSize;
+    _stream.next_out = output.data();
+    _stream.avail_out = outputSize;
+
+    int result = inflate(&_stream, Z_NO_FLUSH);
+    if (result == Z_STREAM_END) {
+        _finished = true;
+    } else if (result != Z_OK && result != Z_BUF_ERROR) {
+        _failed = true;
+    }
+
+    input = input.subspan(inputSize - _stream.avail_in);
+    return outputSize - _stream.avail_out;
+}
+#endif
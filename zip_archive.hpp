@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nonstd/span.hpp>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// Just enough of the .zip format to find an entry and read it front to back.
+// The central directory is parsed from spans of the archive that the caller reads,
+// so it works the same whether the archive is mapped or streamed.
+
+constexpr uint16_t ZIP_METHOD_STORED = 0;
+constexpr uint16_t ZIP_METHOD_DEFLATED = 8;
+
+// The end of central directory record sits in this many bytes at the end of the archive (it ends with a comment of up to 64 KB)
+constexpr size_t ZIP_DIRECTORY_SEARCH_SIZE = 22 + 0xffff;
+constexpr size_t ZIP64_DIRECTORY_RECORD_SIZE = 56;
+constexpr size_t ZIP_LOCAL_HEADER_SIZE = 30;
+
+struct ZipDirectoryLocation {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint64_t zip64RecordOffset = UINT64_MAX; // Where the ZIP64 record with the real offset and size is, if there is one
+};
+
+struct ZipEntry {
+    std::string name;
+    uint64_t localHeaderOffset = 0;
+    uint64_t compressedSize = 0;
+    uint64_t size = 0;
+    uint32_t crc32 = 0;
+    uint16_t method = ZIP_METHOD_STORED;
+
+    [[nodiscard]] bool IsDirectory() const noexcept { return !name.empty() && name.back() == '/'; }
+};
+
+// tail is the last bytes of the archive, starting at tailOffset
+[[nodiscard]] bool FindZipDirectory(nonstd::span<const uint8_t> tail, uint64_t tailOffset, ZipDirectoryLocation& location) noexcept;
+[[nodiscard]] bool ReadZip64DirectoryRecord(nonstd::span<const uint8_t> record, ZipDirectoryLocation& location) noexcept;
+[[nodiscard]] bool ReadZipDirectory(nonstd::span<const uint8_t> directory, std::vector<ZipEntry>& entries);
+
+// Returns the offset of the entry's data, given the local header that precedes it
+[[nodiscard]] bool GetZipDataOffset(nonstd::span<const uint8_t> localHeader, const ZipEntry& entry, uint64_t& offset) noexcept;
+
+// The named entry, or (given null or an empty name) the largest file, which for a ROM set is the ROM and not its readme
+[[nodiscard]] const ZipEntry* SelectZipEntry(const std::vector<ZipEntry>& entries, const char* name) noexcept;
+
+#ifdef HAVE_ZLIB
+// Inflates a raw deflate stream (as .zip stores them) a piece at a time; only zlib's 32 KB window is kept between pieces
+class ZipInflater {
+public:
+    ZipInflater() noexcept;
+    ~ZipInflater() noexcept;
+    ZipInflater(const ZipInflater&) = delete;
+    ZipInflater& operator=(const ZipInflater&) = delete;
+    ZipInflater(ZipInflater&&) = delete;
+    ZipInflater& operator=(ZipInflater&&) = delete;
+
+    [[nodiscard]] bool IsValid() const noexcept { return _initialized; }
+    [[nodiscard]] bool IsFinished() const noexcept { return _finished; }
+    [[nodiscard]] bool HasFailed() const noexcept { return _failed; }
+
+    // Starts over at the beginning of a new stream
+    void Reset() noexcept;
+
+    // Inflates as much of input into output as fits, moves input past whatever was consumed,
+    // and returns how many bytes were written.
+    size_t Inflate(nonstd::span<const uint8_t>& input, nonstd::span<uint8_t> output) noexcept;
+
+private:
+    z_stream _stream {};
+    bool _initialized = false;
+    bool _finished = false;
+    bool _failed = false;
+};
+#endif